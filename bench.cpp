@@ -0,0 +1,343 @@
+
+/*
+ * Compile:
+ *    make kalah-bench
+ *
+ * Usage:
+ *    ./kalah-bench [-c bench.txt] [-m depth] [-a depth] [-b baseline.csv]
+ *    ./kalah-bench [-c bench.txt] -l evaluations
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "game.h"
+#include "table.h"
+#include "endgame.h"
+#include "book.h"
+#include "stats.h"
+#include "player.h"
+
+using namespace std;
+
+static long allocations = 0;		// Heap allocations so far
+
+// Count every heap allocation, to show the search makes none
+void *operator new ( size_t size )
+{
+	allocations++;
+	void *block = malloc (size > 0 ? size : 1);
+	if (block == NULL) throw bad_alloc();
+	return(block);
+}
+
+void operator delete ( void *block ) noexcept
+{
+	free (block);
+}
+
+void operator delete ( void *block, size_t ) noexcept
+{
+	free (block);
+}
+
+const int BENCHMINIMAX = 6;		// Default minimax depth
+const int BENCHALPHABETA = 11;		// Default alpha-beta depth
+
+// Correct usage
+void Usage ( char *argv[] )
+{
+	cerr << "Usage: " << argv[0] << " [-c bench.txt] [-m depth] [-a depth] [-b baseline.csv]" << endl;
+	cerr << "       " << argv[0] << " [-c bench.txt] -l evaluations" << endl;
+}
+
+// Benchmark position
+typedef struct {
+	int pits[PITS];			// Seeds in packed pits
+	int playing;			// Player to move
+} BenchPosition;
+
+// Totals over corpus at one depth
+typedef struct {
+	double nodes;			// Nodes searched at this depth
+	double secs;			// Seconds searching this depth
+	double todepth;			// Seconds from depth 1 to this depth
+	double allocs;			// Heap allocations searching this depth
+} BenchTotals;
+
+// Read benchmark positions
+int ReadCorpus ( char *file, vector<BenchPosition> &corpus )
+{
+	ifstream corpfile(file);
+	if (!corpfile) {
+		cerr << "ERROR: Unable to read " << file << "." << endl;
+		return(1);
+	}
+
+	string line;
+	int lineno = 0;
+	while (getline (corpfile, line)) {
+		lineno++;
+		istringstream words(line);
+		BenchPosition pos;
+		if (!(words >> pos.playing) || (line[0] == '#')) continue;
+
+		int p, total = 0;
+		for (p = 0; p < PITS; p++) {
+			if (!(words >> pos.pits[p]) || (pos.pits[p] < 0)) break;
+			total += pos.pits[p];
+		}
+		if ((p < PITS) || (total != ALLSEEDS) || (pos.playing < 1) || (pos.playing > 2)) {
+			cerr << file << ":" << lineno << ": bad position." << endl;
+			return(2);
+		}
+		corpus.push_back(pos);
+	}
+	return(0);
+}
+
+// Baseline results by algorithm, evalfunc and depth
+typedef map<string, pair<double,double> > Baseline;  // Nodes, nodes/sec
+
+// Read baseline results written by an earlier run
+void ReadBaseline ( char *file, Baseline &base )
+{
+	ifstream basefile(file);
+	string line;
+
+	getline (basefile, line);	// Header
+	while (getline (basefile, line)) {
+		istringstream fields(line);
+		string algorithm, evalfunc, depth, nodes, secs, nps;
+		getline (fields, algorithm, ',');
+		getline (fields, evalfunc, ',');
+		getline (fields, depth, ',');
+		getline (fields, nodes, ',');
+		getline (fields, secs, ',');
+		getline (fields, nps, ',');
+		base[algorithm + "," + evalfunc + "," + depth] = make_pair(atof(nodes.c_str()), atof(nps.c_str()));
+	}
+}
+
+// Search every position to every depth up to depth, one player each,
+// keeping its table from depth to depth as iterative deepening would
+void BenchSearch ( vector<BenchPosition> &corpus, string algorithm, string evalfunc,
+		   int depth, vector<BenchTotals> &totals )
+{
+	BenchTotals zero = { 0, 0, 0, 0 };
+	size_t c;
+	int d;
+
+	totals.assign(depth+1, zero);
+	for (c = 0; c < corpus.size(); c++) {
+		Game game(corpus[c].pits);
+		Player pl(algorithm, evalfunc, corpus[c].playing, 0);
+		double todepth = 0;
+
+		for (d = 1; d <= depth; d++) {
+			SearchLimits limits;
+			limits.depth = d;
+			limits.movetime = limits.gametime = 0;
+			limits.nodes = 0;
+			limits.threads = 1;
+
+			Moves movements;
+			struct timeval starter;
+			long nodes = pl.Context().Nodes();
+			long allocs = allocations;
+			gettimeofday (&starter, NULL);
+			pl.Think (game, limits, movements);
+			double secs = TimeSince(&starter);
+			totals[d].allocs += allocations - allocs;
+
+			todepth += secs;
+			totals[d].nodes += pl.Context().Nodes() - nodes;
+			totals[d].secs += secs;
+			totals[d].todepth += todepth;
+		}
+	}
+}
+
+// Evaluate by name at every leaf, as players did before evaluation
+// policies, to compare against
+static int NamedEvaluate ( Game &game, int player, const string &evalfunc )
+{
+	if (evalfunc == EVALFUNCS[0]) {
+		return(game.NetScore(player));
+	} else if (evalfunc == EVALFUNCS[1]) {
+		return(game.MyScore(player));
+	}
+	return(-1);
+}
+
+volatile long benchsink;		// Keeps evaluations from being optimised away
+
+// Evaluate corpus positions evals times by policy
+template <class Eval>
+static double PolicyLeaves ( vector<Game> &games, long evals )
+{
+	struct timeval starter;
+	long sum = 0;
+	long e;
+
+	gettimeofday (&starter, NULL);
+	for (e = 0; e < evals; e++) {
+		sum += Eval::Evaluate (games[e % games.size()], 1 + (e & 1));
+	}
+	benchsink = sum;
+	return(TimeSince(&starter));
+}
+
+// Evaluate corpus positions evals times by name
+static double NamedLeaves ( vector<Game> &games, long evals, const string &evalfunc )
+{
+	struct timeval starter;
+	long sum = 0;
+	long e;
+
+	gettimeofday (&starter, NULL);
+	for (e = 0; e < evals; e++) {
+		sum += NamedEvaluate (games[e % games.size()], 1 + (e & 1), evalfunc);
+	}
+	benchsink = sum;
+	return(TimeSince(&starter));
+}
+
+// Leaf evaluation microbenchmark: evaluations per second by name and by
+// policy for each evaluation function
+void BenchLeaves ( vector<BenchPosition> &corpus, long evals )
+{
+	vector<Game> games;
+	size_t c;
+	int f;
+
+	for (c = 0; c < corpus.size(); c++) {
+		games.push_back(Game(corpus[c].pits));
+	}
+
+	cout << "evalfunc,dispatch,evaluations,secs,evals_per_sec" << endl;
+	for (f = 0; f < 2; f++) {
+		double named = NamedLeaves (games, evals, EVALFUNCS[f]);
+		double policy = (f == 0 ? PolicyLeaves<NetScoreEval> (games, evals)
+					: PolicyLeaves<MyScoreEval> (games, evals));
+		cout << EVALFUNCS[f] << ",name," << evals << "," << named << ","
+		     << (long)(named > 0 ? evals / named : 0) << endl;
+		cout << EVALFUNCS[f] << ",policy," << evals << "," << policy << ","
+		     << (long)(policy > 0 ? evals / policy : 0) << endl;
+	}
+}
+
+// Depth to search algorithm to: principal variation search goes as
+// deep as alpha-beta
+static int BenchDepth ( int depths[], int a )
+{
+	return(a == 0 ? depths[0] : depths[1]);
+}
+
+int main ( int argc, char *argv[] )
+{
+	char corpdefault[] = "bench.txt";
+	char *corpfile = corpdefault;	// Benchmark positions
+	char *basefile = NULL;		// Earlier results
+	long leaves = 0;		// Leaf evaluations to time instead
+	int depths[2] = { BENCHMINIMAX, BENCHALPHABETA };
+	int opt;
+
+	while ((opt = getopt (argc, argv, "c:m:a:b:l:")) != -1) {
+		switch (opt) {
+		case 'c':		// Benchmark positions
+			corpfile = optarg;
+			break;
+
+		case 'm':		// Minimax depth
+			depths[0] = atoi(optarg);
+			break;
+
+		case 'a':		// Alpha-beta and PVS depth
+			depths[1] = atoi(optarg);
+			break;
+
+		case 'b':		// Baseline results
+			basefile = optarg;
+			break;
+
+		case 'l':		// Leaf evaluations
+			leaves = atol(optarg);
+			if (leaves <= 0) {
+				Usage(argv);
+				return(1);
+			}
+			break;
+
+		default:
+			Usage(argv);
+			return(1);
+		}
+	}
+	if ((depths[0] < 1) || (depths[0] > MAXDEPTH) || (depths[1] < 1) || (depths[1] > MAXDEPTH)) {
+		Usage(argv);
+		return(1);
+	}
+
+	vector<BenchPosition> corpus;
+	if (ReadCorpus (corpfile, corpus)) return(2);
+
+	if (leaves > 0) {
+		BenchLeaves (corpus, leaves);
+		return(0);
+	}
+
+	Baseline base;
+	if (basefile != NULL) ReadBaseline (basefile, base);
+
+	cout << "algorithm,evalfunc,depth,nodes,secs,nodes_per_sec,time_to_depth,ebf,max_rss_kb,allocs_per_node,nodes_vs_alphabeta";
+	if (basefile != NULL) cout << ",nodes_vs_base,nps_vs_base";
+	cout << endl;
+
+	// Search everything first, so every algorithm's nodes can be set
+	// against alpha-beta's at the same depth
+	vector<BenchTotals> totals[3][2];
+	int a, f, d;
+	for (a = 0; a < 3; a++) {
+		for (f = 0; f < 2; f++) {
+			BenchSearch (corpus, ALGORITHMS[a], EVALFUNCS[f], BenchDepth (depths, a), totals[a][f]);
+		}
+	}
+
+	for (a = 0; a < 3; a++) {
+		for (f = 0; f < 2; f++) {
+			vector<BenchTotals> &alphabeta = totals[1][f];
+			for (d = 1; d <= BenchDepth (depths, a); d++) {
+				BenchTotals &t = totals[a][f][d];
+				double nps = (t.secs > 0 ? t.nodes / t.secs : 0);
+				double ebf = (totals[a][f][d-1].nodes > 0 ? t.nodes / totals[a][f][d-1].nodes : 0);
+				cout << ALGORITHMS[a] << "," << EVALFUNCS[f] << "," << d << ","
+				     << (long)t.nodes << "," << t.secs << "," << (long)nps << ","
+				     << t.todepth / corpus.size() << "," << ebf << "," << MaxMemory() << ","
+				     << (t.nodes > 0 ? t.allocs / t.nodes : 0) << ",";
+				if ((d < (int)alphabeta.size()) && (alphabeta[d].nodes > 0)) {
+					cout << t.nodes / alphabeta[d].nodes;
+				}
+
+				if (basefile != NULL) {
+					ostringstream key;
+					key << ALGORITHMS[a] << "," << EVALFUNCS[f] << "," << d;
+					Baseline::iterator b = base.find(key.str());
+					if ((b != base.end()) && (b->second.first > 0) && (b->second.second > 0)) {
+						cout << "," << t.nodes / b->second.first << "," << nps / b->second.second;
+					} else {
+						cout << ",,";
+					}
+				}
+				cout << endl;
+			}
+		}
+	}
+	return(0);
+}
@@ -0,0 +1,119 @@
+
+/*
+ * Compile:
+ *    make
+ *
+ * Usage:
+ *    ./kalah -b kalah.book -d depth -1 player1.txt -2 player2.txt
+ */
+
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "game.h"
+#include "book.h"
+
+using namespace std;
+
+OpeningBook::OpeningBook ( )
+{
+	map = NULL;
+	mapsize = 0;
+	book = NULL;
+	entries = 0;
+}
+
+OpeningBook::~OpeningBook ( )
+{
+	if (map != NULL) munmap (map, mapsize);
+}
+
+// Map book file, 0 when ready
+int OpeningBook::Open ( const char *file )
+{
+	int fd = open (file, O_RDONLY);
+	if (fd < 0) {
+		cerr << "ERROR: Unable to open opening book " << file << "." << endl;
+		return(1);
+	}
+
+	struct stat st;
+	if ((fstat (fd, &st) != 0) || (st.st_size < (off_t)sizeof(BookHeader))) {
+		cerr << "ERROR: Opening book " << file << " too short." << endl;
+		close (fd);
+		return(2);
+	}
+
+	mapsize = st.st_size;
+	map = mmap (NULL, mapsize, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);			// Mapping stays
+	if (map == MAP_FAILED) {
+		cerr << "ERROR: Unable to map opening book " << file << "." << endl;
+		map = NULL;
+		return(3);
+	}
+
+	BookHeader *header = (BookHeader *)map;
+	if ((memcmp (header->magic, BOOKMAGIC, sizeof(header->magic)) != 0) ||
+	    (header->entries < 0) ||
+	    (mapsize < sizeof(BookHeader) + header->entries * sizeof(BookEntry))) {
+		cerr << "ERROR: " << file << " is not a Kalah opening book." << endl;
+		munmap (map, mapsize);
+		map = NULL;
+		return(4);
+	}
+
+	book = (const BookEntry *)((char *)map + sizeof(BookHeader));
+	entries = header->entries;
+	return(0);
+}
+
+// Book move for player to move in game, zero if none
+template <class G>
+int OpeningBook::Lookup ( G &game, int playing, Moves &movements )
+{
+	if ((G::HOLES != Game::HOLES) || (G::INITSEEDS != Game::INITSEEDS)) return(0);
+
+	HashKey key = game.Hash(playing);
+	long low = 0, high = entries;	// Binary search of sorted keys
+
+	while (low < high) {
+		long mid = low + (high - low) / 2;
+		if (book[mid].key < key) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	if ((low >= entries) || (book[low].key != key)) return(0);
+
+	// Moves must play out on this game, in case keys collide
+	const BookEntry *entry = &book[low];
+	if (entry->moves == 0) return(0);	// Turn too long to store
+	G trial(game);
+	int m;
+	for (m = 0; m < entry->moves; m++) {
+		char allowed[MAXHOLES];
+		int moves = trial.MovesAllowed (allowed, playing);
+		if (memchr (allowed, entry->move[m], moves) == NULL) return(0);
+		int endpt = trial.KalahMove (playing, G::ChooseHole (playing, entry->move[m]));
+		int more = (m+1 < entry->moves);
+		if (more && (endpt != G::WELL)) return(0);  // Turn ends early
+		if (!more && (endpt == G::WELL) && (trial.MovesAllowed (allowed, playing) > 0)) {
+			return(0);		// Bonus move missing
+		}
+	}
+
+	movements.clear();
+	for (m = 0; m < entry->moves; m++) {
+		movements.push_back(entry->move[m]);
+	}
+	return(1);
+}
+
+// Lookups on every board variant
+#define BOOK_VARIANT(n,s) template int OpeningBook::Lookup ( KalahGame<n,s> &game, int playing, Moves &movements );
+KALAH_VARIANTS(BOOK_VARIANT)
@@ -0,0 +1,62 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+/*
+ * Compile:
+ *    make mkbook
+ *
+ * Usage:
+ *    ./mkbook -p plies -d depth -o kalah.book
+ *    ./kalah -b kalah.book -d depth -1 player1.txt -2 player2.txt
+ */
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+const int BOOKMOVES = 12;		// Longest move with bonus moves in book
+const char BOOKMAGIC[8] = { 'K','A','L','A','H','B','K','2' };
+
+// Opening book file header, followed by entries sorted by key
+typedef struct {
+	char magic[8];			// BOOKMAGIC
+	int plies;			// Turns from start in book
+	int depth;			// Depth searched
+	long long entries;		// Entries that follow
+} BookHeader;
+
+// Opening book entry
+typedef struct {
+	HashKey key;			// Position with player to move
+	short score;			// Score searched, netscore or myscore as built
+	unsigned char depth;		// Depth searched
+	unsigned char moves;		// Moves in turn
+	char move[BOOKMOVES];		// Move and its bonus moves
+} BookEntry;
+
+// Opening book, memory mapped read-only
+class OpeningBook {
+public:
+	OpeningBook ( );
+	~OpeningBook ( );
+
+	// Map book file, 0 when ready
+	int Open ( const char *file );
+
+	// Positions in book
+	inline long Entries ( ) { return(entries); }
+
+	// Book move for player to move in game, zero if none.  Books are
+	// of the standard board, other boards find nothing.
+	template <class G>
+	int Lookup ( G &game, int playing, Moves &movements );
+
+private:
+	void *map;			// File mapping
+	size_t mapsize;			// Bytes mapped
+	const BookEntry *book;		// Entries in mapping
+	long entries;			// Entries in book
+};
+
+#endif
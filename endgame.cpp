@@ -0,0 +1,194 @@
+
+/*
+ * Compile:
+ *    make
+ *
+ * Usage:
+ *    ./kalah -e kalah.egdb -d depth -1 player1.txt -2 player2.txt
+ */
+
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "game.h"
+#include "endgame.h"
+
+using namespace std;
+
+const int PARTS = 12;			// Holes indexed, both players
+
+// Counting tables for indexing boards
+typedef struct {
+	long ways[PARTS+1][ENDGAMEMAX+1];  // Ways to put seeds in holes
+	long below[ENDGAMEMAX+2];	// Boards with fewer seeds on board
+	// Boards skipped by putting fewer seeds in a hole, by holes after
+	// it and seeds left
+	long skip[PARTS][ENDGAMEMAX+1][ENDGAMEMAX+1];
+} IndexTables;
+
+static IndexTables *MakeTables ( )
+{
+	static IndexTables tables;
+	int k, n, x;
+
+	for (n = 0; n <= ENDGAMEMAX; n++) {
+		tables.ways[0][n] = (n == 0);
+	}
+	for (k = 1; k <= PARTS; k++) {	// Ways over k holes
+		for (n = 0; n <= ENDGAMEMAX; n++) {
+			tables.ways[k][n] = 0;
+			for (x = 0; x <= n; x++) {
+				tables.ways[k][n] += tables.ways[k-1][n-x];
+			}
+		}
+	}
+	tables.below[0] = 0;
+	for (n = 0; n <= ENDGAMEMAX; n++) {
+		tables.below[n+1] = tables.below[n] + tables.ways[PARTS][n];
+	}
+	for (k = 0; k < PARTS; k++) {
+		for (n = 0; n <= ENDGAMEMAX; n++) {
+			tables.skip[k][n][0] = 0;
+			for (x = 1; x <= n; x++) {
+				tables.skip[k][n][x] = tables.skip[k][n][x-1] + tables.ways[k][n-x+1];
+			}
+		}
+	}
+	return(&tables);
+}
+
+static IndexTables *Tables ( )
+{
+	static IndexTables *tables = MakeTables();
+	return(tables);
+}
+
+// Index of board with seeds in mover's and opponent's holes
+long EndgameIndex ( int mine[6], int theirs[6] )
+{
+	IndexTables *t = Tables();
+	int seeds = 0;
+	int h;
+
+	for (h = 0; h < 6; h++) {
+		seeds += mine[h] + theirs[h];
+	}
+
+	long index = t->below[seeds];
+	int left = seeds;
+	for (h = 0; h < PARTS-1; h++) {	// Last hole takes what is left
+		int x = (h < 6 ? mine[h] : theirs[h-6]);
+		index += t->skip[PARTS-1-h][left][x];
+		left -= x;
+	}
+	return(index);
+}
+
+// Board at index
+void EndgameBoard ( long index, int mine[6], int theirs[6] )
+{
+	IndexTables *t = Tables();
+	int seeds = 0;
+	int h;
+
+	while (t->below[seeds+1] <= index) seeds++;
+	index -= t->below[seeds];
+
+	int left = seeds;
+	for (h = 0; h < PARTS; h++) {
+		int x = 0;
+		if (h < PARTS-1) {
+			while ((x < left) && (t->skip[PARTS-1-h][left][x+1] <= index)) x++;
+			index -= t->skip[PARTS-1-h][left][x];
+		} else {
+			x = left;
+		}
+		if (h < 6) mine[h] = x; else theirs[h-6] = x;
+		left -= x;
+	}
+}
+
+// Boards with at most seeds on board
+long EndgamePositions ( int seeds )
+{
+	return(Tables()->below[seeds+1]);
+}
+
+EndgameDB::EndgameDB ( )
+{
+	map = NULL;
+	mapsize = 0;
+	values = NULL;
+	maxseeds = 0;
+}
+
+EndgameDB::~EndgameDB ( )
+{
+	if (map != NULL) munmap (map, mapsize);
+}
+
+// Map database file, 0 when ready
+int EndgameDB::Open ( const char *file )
+{
+	int fd = open (file, O_RDONLY);
+	if (fd < 0) {
+		cerr << "ERROR: Unable to open endgame database " << file << "." << endl;
+		return(1);
+	}
+
+	struct stat st;
+	if ((fstat (fd, &st) != 0) || (st.st_size < (off_t)sizeof(EndgameHeader))) {
+		cerr << "ERROR: Endgame database " << file << " too short." << endl;
+		close (fd);
+		return(2);
+	}
+
+	mapsize = st.st_size;
+	map = mmap (NULL, mapsize, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);			// Mapping stays
+	if (map == MAP_FAILED) {
+		cerr << "ERROR: Unable to map endgame database " << file << "." << endl;
+		map = NULL;
+		return(3);
+	}
+
+	EndgameHeader *header = (EndgameHeader *)map;
+	if ((memcmp (header->magic, ENDGAMEMAGIC, sizeof(header->magic)) != 0) ||
+	    (header->holes != 6) || (header->maxseeds < 0) ||
+	    (header->maxseeds > ENDGAMEMAX) ||
+	    (header->positions != EndgamePositions (header->maxseeds)) ||
+	    (mapsize < sizeof(EndgameHeader) + header->positions)) {
+		cerr << "ERROR: " << file << " is not a Kalah endgame database." << endl;
+		munmap (map, mapsize);
+		map = NULL;
+		return(4);
+	}
+
+	values = (const signed char *)map + sizeof(EndgameHeader);
+	maxseeds = header->maxseeds;
+	return(0);
+}
+
+// Net score the player to move still gains from the board by best play,
+// if the board is in the database
+template <class G>
+int EndgameDB::Probe ( G &game, int playing, int *value )
+{
+	if ((G::WELL != 6) || (game.SeedsInPlay() > maxseeds)) return(0);
+
+	int mine[6], theirs[6];
+	int opp = Opponent(playing);
+	int h;
+	for (h = 0; h < 6; h++) {
+		mine[h] = game.Seeds(playing,h);
+		theirs[h] = game.Seeds(opp,h);
+	}
+	*value = values[EndgameIndex (mine, theirs)];
+	return(1);
+}
+
+// Lookups on every board variant
+#define ENDGAME_VARIANT(n,s) template int EndgameDB::Probe ( KalahGame<n,s> &game, int playing, int *value );
+KALAH_VARIANTS(ENDGAME_VARIANT)
@@ -0,0 +1,65 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+/*
+ * Compile:
+ *    make mkendgame
+ *
+ * Usage:
+ *    ./mkendgame -s seeds -o kalah.egdb
+ *    ./kalah -e kalah.egdb -d depth -1 player1.txt -2 player2.txt
+ */
+
+#include <cstddef>
+
+using namespace std;
+
+const int ENDGAMESEEDS = 12;		// Default seeds on board in database
+const int ENDGAMEMAX = 20;		// Most seeds on board a database holds
+const char ENDGAMEMAGIC[8] = { 'K','A','L','A','H','E','G','2' };
+
+// Endgame database file header, followed by one signed byte per index
+typedef struct {
+	char magic[8];			// ENDGAMEMAGIC
+	int maxseeds;			// Seeds on board solved
+	int holes;			// Holes per player
+	long long positions;		// Values that follow
+} EndgameHeader;
+
+// Index of board with seeds in mover's and opponent's holes.  Boards
+// are ordered by seeds on board, so a database of fewer seeds is a
+// prefix of one with more.
+long EndgameIndex ( int mine[6], int theirs[6] );
+
+// Board at index
+void EndgameBoard ( long index, int mine[6], int theirs[6] );
+
+// Boards with at most seeds on board
+long EndgamePositions ( int seeds );
+
+// Solved endgames, memory mapped read-only
+class EndgameDB {
+public:
+	EndgameDB ( );
+	~EndgameDB ( );
+
+	// Map database file, 0 when ready
+	int Open ( const char *file );
+
+	// Most seeds on board solved, 0 if none
+	inline int MaxSeeds ( ) { return(maxseeds); }
+
+	// Net score the player to move still gains from the board by best
+	// play, if the board is in the database.  Boards of 6 holes a
+	// player share one database, whatever seeds they started with.
+	template <class G>
+	int Probe ( G &game, int playing, int *value );
+
+private:
+	void *map;			// File mapping
+	size_t mapsize;			// Bytes mapped
+	const signed char *values;	// Solved values in mapping
+	int maxseeds;			// Seeds on board solved
+};
+
+#endif
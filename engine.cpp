@@ -0,0 +1,254 @@
+
+/*
+ * Compile:
+ *    make libkalah.a
+ *
+ * Usage:
+ *    Engine<Game> engine(args, out);
+ *    engine.PlayKalah();
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/time.h>
+#include "game.h"
+#include "table.h"
+#include "endgame.h"
+#include "book.h"
+#include "stats.h"
+#include "player.h"
+#include "record.h"
+#include "engine.h"
+
+using namespace std;
+
+template <class G>
+Engine<G>::Engine ( CommandArgs args, ostream &out )
+	: context(out), p1(args.file1,1,!args.quiet,&context), p2(args.file2,2,!args.quiet,&context), game()
+{
+	if ((args.endgame != NULL) && (endgame.Open (args.endgame) == 0)) {
+		p1.SetEndgame(&endgame);
+		p2.SetEndgame(&endgame);
+	}
+	if ((args.book != NULL) && (book.Open (args.book) == 0)) {
+		p1.SetBook(&book);
+		p2.SetBook(&book);
+	}
+	KalahInit(args.limits);
+	statsfile = args.stats;
+	quiet = args.quiet;
+	ponder = args.ponder;
+	recordfile = args.records;
+	gamefile = args.games;
+	gamerecord.Start (p1.Config(), p2.Config(), G::WELL);
+}
+
+template <class G>
+Engine<G>::Engine ( InputArgs args, ostream &out )
+	: context(out), p1(args.algorithm1,args.evalfunc1,1,1,HASHSIZE,0,&context),
+	  p2(args.algorithm2,args.evalfunc2,2,1,HASHSIZE,0,&context), game()
+{
+	SearchLimits l;
+	l.depth = args.depth;		// Fixed depth only
+	l.movetime = l.gametime = 0;
+	l.nodes = 0;
+	l.threads = 1;
+	KalahInit(l);
+	statsfile = NULL;
+	quiet = 0;
+	ponder = 0;
+	recordfile = NULL;
+	gamefile = NULL;
+}
+
+// Complete initialization of Kalah game
+template <class G>
+void Engine<G>::KalahInit ( SearchLimits &l )
+{
+	limits = l;
+
+	turn = 0;			// Starting
+	win = 0;			// Nobody won
+	context.AddNodes (1);		// Start position
+
+	struct timezone timezone;
+	if (gettimeofday (&starter, &timezone)) {
+		cerr << "ERROR: Unable to read system time." << endl;
+	}
+}
+
+// Play Kalah game
+template <class G>
+void Engine<G>::PlayKalah ( )
+{
+	while (win <= 0) {		// Until game won
+		if (!quiet) {
+			context.Out() << "Game before turn " << (turn+1) << endl;
+			game.Display(context.Out());
+		}
+
+		KalahPlayer<G> *pl = ((turn++ % 2) == 0 ? &p1 : &p2);	// Player turn
+		int first = context.Records();
+		long nodes = context.Nodes();
+		struct timeval turnstart;
+		gettimeofday (&turnstart, NULL);
+		win = pl->TakeTurn (game, limits);
+		if (win < 0) {		// Take a loss
+			win = Opponent(pl->Who());
+		}
+		if (ponder && (win <= 0)) {	// Think on opponent's turn
+			pl->StartPonder (game, limits);
+		}
+
+		if (quiet || (gamefile != NULL)) {
+			RecordTurn (pl, first, context.Nodes() - nodes, TimeSince(&turnstart));
+		}
+		if (!quiet) {
+			context.Out() << "Game after turn " << turn << endl;
+			game.Display(context.Out());
+			context.Out() << endl;
+		}
+	}
+	p1.StopPonder (0);		// Game over, nothing to ponder
+	p2.StopPonder (0);
+}
+
+// Record player's turn just taken, one JSON line and a binary game
+// record turn
+template <class G>
+void Engine<G>::RecordTurn ( KalahPlayer<G> *pl, int first, long nodes, double secs )
+{
+	int r;
+
+	if (context.Records() == first) return;	// No move, game over
+
+	if (gamefile != NULL) {
+		char letters[MAXCHAIN];
+		for (r = first; r < context.Records(); r++) {
+			letters[r - first] = context.Recorded(r);
+		}
+		gamerecord.AddTurn (pl->Who(), letters, context.Records() - first,
+				    pl->TurnFromBook() ? RECORDNOSCORE : pl->TurnScore(), nodes, secs);
+	}
+	if (!quiet) return;
+
+	records << "{\"turn\":" << turn << ",\"player\":" << pl->Who() << ",\"moves\":\"";
+	for (r = first; r < context.Records(); r++) {
+		records << context.Recorded(r);
+	}
+	records << "\",\"score\":";
+	if (pl->TurnFromBook()) {
+		records << "null";
+	} else {
+		records << pl->TurnScore();
+	}
+	records << ",\"nodes\":" << nodes << ",\"secs\":" << secs
+		<< ",\"stores\":[" << game.Score(1) << "," << game.Score(2) << "]}\n";
+}
+
+// Write move records, buffered until game end
+template <class G>
+void Engine<G>::WriteRecords ( )
+{
+	records << "{\"result\":" << (game.Score(1) == game.Score(2) ? 0 : win)
+		<< ",\"score\":[" << game.Score(1) << "," << game.Score(2) << "]"
+		<< ",\"turns\":" << turn << ",\"nodes\":" << context.Nodes()
+		<< ",\"secs\":" << TimeSince(&starter) << "}\n";
+
+	if (recordfile == NULL) {
+		context.Out() << records.str() << flush;
+		return;
+	}
+	ofstream out(recordfile);
+	out << records.str();
+	if (!out) {
+		cerr << "ERROR: Unable to write " << recordfile << "." << endl;
+	}
+}
+
+// Append game to binary game records
+template <class G>
+void Engine<G>::WriteGame ( )
+{
+	if (gamefile == NULL) return;
+
+	RecordWriter writer;
+	gamerecord.Finish (game);
+	if (writer.Open (gamefile, G::WELL, G::INITSEEDS) || writer.Write (gamerecord)) {
+		cerr << "ERROR: Unable to write " << gamefile << "." << endl;
+	}
+}
+
+// Output how often player's first move tried cut off search
+template <class P>
+void DispCutoffs ( ostream &out, P &pl )
+{
+	long cutoffs = pl.Cutoffs();
+	out << "Player " << pl.Who() << " cutoffs: " << cutoffs;
+	if (cutoffs > 0) {
+		out << ", " << (100.0 * pl.FirstCutoffs() / cutoffs) << "% by first move";
+	}
+	out << "." << endl;
+}
+
+// Output Kalah statistics
+template <class G>
+void Engine<G>::DispStats ( )
+{
+	if (quiet) {			// Final record instead
+		WriteRecords();
+		return;
+	}
+
+	int myscore = game.Score(1);	// Watch for ties
+	int oppscore = game.Score(2);
+	context.Out() << endl << "Game FINAL:" << endl;
+	game.Display(context.Out());
+
+	if (myscore == oppscore) {
+		context.Out() << "The game was TIED!" << endl << endl;
+	} else {
+		context.Out() << "Player " << win << " WINS!" << endl << endl;
+	}
+	context.Replay();
+	context.Out() << endl;
+
+	context.Out() << "Game played " << turn << " turns." << endl;
+	context.Out() << "Game nodes generated: " << context.Nodes() << endl;
+	context.Out() << "Game nodes expanded: " << (context.Nodes() - (context.Records()+1)) << endl;
+	context.Out() << "Player 1 table hits: " << p1.TableHits() << " of " << p1.TableProbes() << " probes." << endl;
+	context.Out() << "Player 2 table hits: " << p2.TableHits() << " of " << p2.TableProbes() << " probes." << endl;
+	DispCutoffs(context.Out(), p1);
+	DispCutoffs(context.Out(), p2);
+	context.Out() << "Book moves: player 1 " << p1.BookMoves() << ", player 2 " << p2.BookMoves() << "." << endl;
+	if (ponder) {
+		context.Out() << "Ponder hits: player 1 " << p1.PonderHits() << " of " << p1.Ponders()
+			      << ", player 2 " << p2.PonderHits() << " of " << p2.Ponders() << "." << endl;
+	}
+	context.Out() << "Game played in " << TimeSince(&starter) << " secs." << endl;
+	context.Out() << "Max. memory usage: " << MaxMemory() << "k" << endl;
+}
+
+// Write players' search statistics as JSON
+template <class G>
+void Engine<G>::WriteStats ( )
+{
+	if (statsfile == NULL) return;
+
+	ofstream out(statsfile);
+	if (!out) {
+		cerr << "ERROR: Unable to write " << statsfile << "." << endl;
+		return;
+	}
+	out << "{" << endl << "  \"player1\": ";
+	p1.Stats().WriteJSON (out, "  ");
+	out << "," << endl << "  \"player2\": ";
+	p2.Stats().WriteJSON (out, "  ");
+	out << endl << "}" << endl;
+}
+
+// Engines on every board variant
+#define ENGINE_VARIANT(n,s) template class Engine<KalahGame<n,s> >;
+KALAH_VARIANTS(ENGINE_VARIANT)
@@ -0,0 +1,96 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+/*
+ * Compile:
+ *    make libkalah.a
+ *
+ * Usage:
+ *    Engine<Game> engine(args, out);
+ *    engine.PlayKalah();
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/time.h>
+
+using namespace std;
+
+typedef struct {
+	int depth;			// Depth
+	string algorithm1, evalfunc1;	// Player 1 options
+	string algorithm2, evalfunc2;	// Player 2 options
+} InputArgs;
+
+typedef struct {
+	SearchLimits limits;		// Depth, time and nodes
+	char *file1, *file2;		// Player description files
+	char *endgame;			// Endgame database file
+	char *book;			// Opening book file
+	char *stats;			// Search statistics file
+	int quiet;			// Records instead of boards?
+	char *records;			// Move records file, else stdout
+	char *games;			// Binary game records file
+	int holes, seeds;		// Board, Kalah(holes,seeds)
+	int ponder;			// Search during opponent's turn?
+} CommandArgs;
+
+// Play Kalah Game on board G
+//
+// An engine plays one game.  Its players share the engine's context,
+// and nothing else is shared, so engines can play side by side on any
+// threads, each writing to its own output.
+template <class G>
+class Engine {
+public:
+	// Initialize Kalah game
+	Engine ( CommandArgs args, ostream &out = cout );
+	Engine ( InputArgs args, ostream &out = cout );
+
+	// Play Kalah game
+	void PlayKalah ( );
+
+	// Output Kalah statistics
+	void DispStats ( );
+
+	// Write players' search statistics as JSON
+	void WriteStats ( );
+
+	// Write move records, buffered until game end
+	void WriteRecords ( );
+
+	// Append game to binary game records
+	void WriteGame ( );
+
+	// Game nodes, moves and output of this game
+	inline SearchContext &Context ( ) { return(context); }
+
+private:
+	SearchContext context;		// Shared by players, so made first
+	KalahPlayer<G> p1;		// Player 1
+	KalahPlayer<G> p2;		// Player 2
+	G game;				// Game position
+	EndgameDB endgame;		// Solved endgames
+	OpeningBook book;		// Opening moves
+	SearchLimits limits;		// Search depth, time and nodes
+	char *statsfile;		// Search statistics file, if any
+	int quiet;			// Records instead of boards?
+	int ponder;			// Search during opponent's turn?
+	char *recordfile;		// Move records file, else context output
+	ostringstream records;		// Move records, written at game end
+	char *gamefile;			// Binary game records file, if any
+	GameRecord gamerecord;		// Game being recorded
+
+	int turn;			// Players take turns
+	int win;			// Who won
+	struct timeval starter;		// Start time
+
+	// Complete initialization of Kalah game
+	void KalahInit ( SearchLimits &l );
+
+	// Record player's turn just taken
+	void RecordTurn ( KalahPlayer<G> *pl, int first, long nodes, double secs );
+};
+
+#endif
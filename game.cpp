@@ -9,152 +9,434 @@
 
 #include <iostream>
 #include <vector>
+#include <sys/resource.h>
 #include "game.h"
 
 using namespace std;
 
-char Hole1 ( int p ) { return(p == 1 ? 'f' : 'A'); }  // Hole 1 label
 int Opponent ( int p ) { return(p == 1 ? 2 : 1); }  // Opponent
-int OppHole ( int myhole ) { return(5 - myhole); }  // Opposite hole
-int ChooseHole ( int playing, char hole ) {
-	if (hole == ' ') return(-1);
-	return(playing == 1 ? Hole1(1)-hole : 5-(hole-Hole1(2)));
+int ChooseHole ( int playing, char hole ) { return(Game::ChooseHole (playing, hole)); }
+char MoveHole ( int playing, int movement ) { return(Game::MoveHole (playing, movement)); }
+
+inline double dbltime ( struct timeval *tim ) {
+	return(tim->tv_sec + tim->tv_usec/1000000.0);
+}
+
+// Elapsed time since start
+double TimeSince ( struct timeval *starter )
+{
+	struct timeval nowtime;
+	struct timezone timezone;
+
+	if (gettimeofday (&nowtime, &timezone) != 0) {
+		cerr << "ERROR: Unable to read system time." << endl;
+	}
+	return(dbltime(&nowtime) - dbltime(starter));
+}
+
+// How much memory did program use?
+long MaxMemory ( )
+{
+	struct rusage resources;	// Resource usage report
+
+	if (getrusage (RUSAGE_SELF, &resources) != 0) {
+		cerr << "ERROR: Unable to read resources." << endl;
+	}
+	return(resources.ru_maxrss);	// Max. resident size
+}
+
+// Seconds in time such as 250ms, 2s or 1.5, -1 if not a time
+double ParseTime ( const char *arg )
+{
+	char *unit;
+	double secs = strtod (arg, &unit);
+
+	if ((unit == arg) || (secs < 0)) return(-1);
+	if (strcmp (unit, "ms") == 0) return(secs / 1000.0);
+	if ((strcmp (unit, "s") == 0) || (*unit == '\0')) return(secs);
+	return(-1);
+}
+
+// Board Kalah(holes,seeds) from holes,seeds, 0 if one of the boards built
+int ParseBoard ( const char *arg, int *holes, int *seeds )
+{
+	if (sscanf (arg, "%d,%d", holes, seeds) != 2) return(1);
+#define BOARD_VARIANT(n,s) if ((*holes == n) && (*seeds == s)) return(0);
+	KALAH_VARIANTS(BOARD_VARIANT)
+	return(2);
+}
+
+// Whole board as one vector, so sowing adds to every pit at once
+typedef unsigned char SowVector __attribute__ ((vector_size (16)));
+
+// Masks of pits a sowing drops seeds in, built at compile time for a
+// board of N holes per player, so a lap is 2N+1 pits
+template <int N>
+struct SowMasks {
+	alignas(16) unsigned char lap[2][16];			// Every pit of a lap, all bits
+	alignas(16) unsigned char rest[2][N][2*N+1][16];	// Pits after hole, seeds past laps
+	unsigned char cycle[2][2*(2*N+1)];			// Pit at each step, twice round
+};
+
+// Pit on packed board of step in player's cycle: player's holes 0-N,
+// then opponent's 0 to N-1
+template <int N>
+static constexpr int CyclePit ( int side, int step )
+{
+	return(step < N+1 ? side*(N+1) + step : (1-side)*(N+1) + step-(N+1));
+}
+
+template <int N>
+static constexpr SowMasks<N> MakeSowMasks ( )
+{
+	SowMasks<N> m = { };
+	const int cycle = 2*N+1;
+	for (int side = 0; side < 2; side++) {	// Declared in loops for constexpr
+		for (int step = 0; step < 2*cycle; step++) {
+			m.cycle[side][step] = CyclePit<N> (side, step % cycle);
+			m.lap[side][CyclePit<N> (side, step % cycle)] = 0xff;
+		}
+		for (int hole = 0; hole < N; hole++) {
+			for (int rest = 0; rest < cycle; rest++) {
+				for (int step = 1; step <= rest; step++) {
+					m.rest[side][hole][rest][CyclePit<N> (side, (hole + step) % cycle)] = 1;
+				}
+			}
+		}
+	}
+	return(m);
 }
-char MoveHole ( int playing, int movement ) {
-	return(playing == 1 ? Hole1(1)-movement : Hole1(2)+5-movement);
+
+template <int N>
+static constexpr SowMasks<N> sowmasks = MakeSowMasks<N>();
+
+template <int N, int S>
+HashKey KalahGame<N,S>::pitkey[PITS];		// Key per pit
+template <int N, int S>
+HashKey KalahGame<N,S>::sidekey;		// Key for player 2 to move
+template <int N, int S>
+HashKey KalahGame<N,S>::lapkey[2];		// Keys of a lap of sowing, per side
+template <int N, int S>
+HashKey KalahGame<N,S>::restkey[2][N][CYCLE];	// Keys of pits after hole, per seeds
+
+// Next pseudo-random key (splitmix64), fixed sequence across runs
+static HashKey RandomKey ( HashKey *state )
+{
+	HashKey z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return(z ^ (z >> 31));
+}
+
+// Generate pit keys, and their sums over the pits a sowing drops in
+template <int N, int S>
+bool KalahGame<N,S>::KeysInit ( )
+{
+	HashKey state = 0x4b616c6168ULL;  // Same keys every run
+	int p, side, hole, rest, step;
+	for (p = 0; p < PITS; p++) {
+		pitkey[p] = RandomKey (&state);
+	}
+	sidekey = RandomKey (&state);
+
+	for (side = 0; side < 2; side++) {
+		lapkey[side] = 0;
+		for (step = 0; step < CYCLE; step++) {
+			lapkey[side] += pitkey[sowmasks<N>.cycle[side][step]];
+		}
+		for (hole = 0; hole < N; hole++) {
+			restkey[side][hole][0] = 0;
+			for (rest = 1; rest < CYCLE; rest++) {
+				step = sowmasks<N>.cycle[side][hole + rest];
+				restkey[side][hole][rest] = restkey[side][hole][rest-1] + pitkey[step];
+			}
+		}
+	}
+	return(true);
 }
 
-int Game::nodes = 0;			// Game nodes generated
+template <int N, int S>
+bool KalahGame<N,S>::keyinit = KalahGame<N,S>::KeysInit();
 
 // Init Kalah game
-Game::Game ( )
+template <int N, int S>
+KalahGame<N,S>::KalahGame ( )
 {
 	int s;
-	for (s = 0; s < 6; s++) {
-		holes[0][s] = holes[1][s] = INITSEEDS;  // Start seeds in holes
+	memset (holes, 0, sizeof(holes));  // No score to start
+	for (s = 0; s < N; s++) {
+		holes[Pit(1,s)] = holes[Pit(2,s)] = INITSEEDS;  // Start seeds in holes
+	}
+	Rehash();
+}
+
+// Init Kalah game at position, seeds in pits of packed board
+template <int N, int S>
+KalahGame<N,S>::KalahGame ( const int pits[PITS] )
+{
+	int p;
+	memset (holes, 0, sizeof(holes));
+	for (p = 0; p < PITS; p++) {
+		holes[p] = pits[p];
 	}
-	holes[0][6] = holes[1][6] = 0;	// No score to start
-	nodes++;
+	Rehash();
 }
 
 // Init Kalah game with current state
-Game::Game ( Game &b4 )
+template <int N, int S>
+KalahGame<N,S>::KalahGame ( const KalahGame &b4 )
 {
-	int s;
-	for (s = 0; s < 7; s++) {
-		holes[0][s] = b4.Seeds(1,s);
-		holes[1][s] = b4.Seeds(2,s);
+	memcpy (holes, b4.holes, sizeof(holes));  // One 128-bit copy
+	hash = b4.hash;
+}
+
+// Hash key of pits from scratch
+template <int N, int S>
+void KalahGame<N,S>::Rehash ( )
+{
+	int p;
+	hash = 0;
+	for (p = 0; p < PITS; p++) {
+		hash += holes[p] * pitkey[p];
 	}
-	nodes++;
 }
 
 // Gather all player's seeds at end
-int Game::Gather ( int player )
+template <int N, int S>
+int KalahGame<N,S>::Gather ( int player )
 {
 	int gather = 0;
 	int s;
-	for (s = 0; s < 6; s++) {
+	for (s = 0; s < N; s++) {
 		gather += EmptySeeds (player, s);  // Gather seeds out of hole
 	}
 	return(gather);
 }
 
 // Moves allowed for player at this stage of the game
-int Game::MovesAllowed ( char allowed[], int playing )
+template <int N, int S>
+int KalahGame<N,S>::MovesAllowed ( char allowed[], int playing )
 {
 	int moves = 0;			// Moves allowed
 	int m;
 
 	if (playing == 1) {		// Player 1
-		for (m = 0; m < 6; m++) {
+		for (m = 0; m < N; m++) {
 			if (Seeds(playing,m) > 0) {
 				allowed[moves++] = Hole1(1)-m;
 			}
 		}
 
 	} else {			// Player 2
-		for (m = 5; m >= 0; m--) {
+		for (m = N-1; m >= 0; m--) {
 			if (Seeds(playing,m) > 0) {
-				allowed[moves++] = Hole1(2)+5-m;
+				allowed[moves++] = Hole1(2)+N-1-m;
 			}
 		}
 	}
 	return(moves);
 }
 
-// Which is adjacent hole?
-int AdjHole ( int hole, int *myside )
+// Player moves seeds from hole
+template <int N, int S>
+int KalahGame<N,S>::KalahMove ( int playing, int movement )
 {
-	int adjhole = hole+1;		// Adjacent shift 1 hole
+	MoveUndo undo;			// Not taken back
+	return(KalahMove (playing, movement, undo));
+}
 
-	if (*myside) {			// If on own side of board
-		if (adjhole > 6) {	// Crossing to other side
-			adjhole = 0;
-			*myside = 0;
-		}
+// Player moves seeds from hole, recording how to take it back
+//
+// Every full lap of 2N+1 seeds drops one in each pit but the opponent's
+// score well, and the rest drop in the pits after the hole, so sowing
+// is two mask additions over the whole board whatever the seeds.  The
+// position key is a sum over pits, so it takes two additions too.
+template <int N, int S>
+int KalahGame<N,S>::KalahMove ( int playing, int movement, MoveUndo &undo )
+{
+	int seeds;			// Seeds to move
+	int opp = Opponent(playing);
+	int pit;			// Pit sown
+
+	if (movement < 0) return(movement);	// No move
+
+	pit = Pit(playing,movement);
+	seeds = holes[pit];		// Pickup seeds
+	SetPit (pit, 0);
+	undo.pit = pit;
+	undo.seeds = seeds;
+	undo.store = Score(playing);
+	SowSeeds (playing-1, movement, seeds, 1);
+
+	int endpt = (movement + seeds) % CYCLE;  // Step where move ends
+	pit = sowmasks<N>.cycle[playing-1][endpt];
+	undo.end = pit;
+	undo.captured = 0;
 
-	} else {			//  On opponent's side
-		if (adjhole > 5) {	// Skip opponent's score hole
-			adjhole = 0;
-			*myside = 1;
+	// If player ends on an empty hole, 
+	if ((endpt < N) && (holes[pit] == 1)) {
+		// Then capture any seeds in opponent's opposite hole
+		int opppit = Pit(opp,OppHole(endpt));
+		int oppseeds = holes[opppit];
+		if (oppseeds > 0) {
+			SetPit (opppit, 0);
+			SetPit (pit, 0);
+			Score(playing, oppseeds+1);
+			undo.captured = oppseeds;
 		}
 	}
-	return(adjhole);
+	undo.store = Score(playing) - undo.store;
+
+	//Display();			// Show game after move
+	return(endpt < HOLES ? endpt : endpt - HOLES);  // Tell player where move ends
 }
 
-// Player moves seeds from hole
-int Game::KalahMove ( int playing, int movement )
+// Add seeds sown from player's hole to the pits after it, or take them
+// back, keeping the hash key up to date
+template <int N, int S>
+void KalahGame<N,S>::SowSeeds ( int side, int movement, int seeds, int sign )
+{
+	SowVector board, lap, rest;
+	int laps = seeds / CYCLE;	// Seeds in every pit
+	int more = seeds % CYCLE;	// Seeds in pits after hole
+
+	memcpy (&board, holes, sizeof(holes));
+	memcpy (&lap, sowmasks<N>.lap[side], sizeof(lap));
+	memcpy (&rest, sowmasks<N>.rest[side][movement][more], sizeof(rest));
+
+	SowVector sown = (lap & (unsigned char)laps) + rest;
+	HashKey keys = laps * lapkey[side] + restkey[side][movement][more];
+	if (sign > 0) {
+		board += sown;
+		hash += keys;
+	} else {
+		board -= sown;
+		hash -= keys;
+	}
+	memcpy (holes, &board, sizeof(holes));
+}
+
+// Player moves seeds from hole one seed at a time, as KalahMove did
+// before sowing by masks.  Kept to check KalahMove against.
+template <int N, int S>
+int KalahGame<N,S>::ReferenceMove ( int playing, int movement, MoveUndo &undo )
 {
 	int seeds;			// Seeds to move
-	int endpt = movement;		// Where move ends
-	int myside = 1;			// Start on player's side
 	int opp = Opponent(playing);
+	int mine = Pit(playing,0);	// Player's first pit
+	int skip = Pit(opp,WELL);	// Opponent's score well
+	int pit;			// Pit sown
 
-	if (movement < 0) return(endpt);	// No move
+	if (movement < 0) return(movement);	// No move
 
-	seeds = EmptySeeds(playing, movement);  // Pickup seeds
-	while (seeds-- > 0) {		// Until seeds distributed
-		endpt = AdjHole (endpt, &myside);
-		if (myside) {
-			DropSeeds (playing, endpt, 1);
-		} else {
-			DropSeeds (opp, endpt, 1);
-		}
+	pit = Pit(playing,movement);
+	seeds = holes[pit];		// Pickup seeds
+	SetPit (pit, 0);
+	undo.pit = pit;
+	undo.seeds = seeds;
+	undo.store = Score(playing);
+	while (seeds > 0) {		// Until seeds distributed
+		if (++pit == PITS) pit = 0;
+		if (pit == skip) continue;  // Skip opponent's score well
+		SetPit (pit, holes[pit]+1);
+		seeds--;
 	}
+	undo.end = pit;
+	undo.captured = 0;
+
+	int endpt = pit - mine;		// Where move ends
+	int myside = (endpt >= 0) && (endpt < HOLES);
 
 	// If player ends on an empty hole, 
-	if (myside && (endpt != 6) && (Seeds(playing,endpt) == 1)) {
+	if (myside && (endpt != WELL) && (holes[pit] == 1)) {
 		// Then capture any seeds in opponent's opposite hole
-		int oppseeds = Seeds(opp,OppHole(endpt));
+		int opppit = Pit(opp,OppHole(endpt));
+		int oppseeds = holes[opppit];
 		if (oppseeds > 0) {
-			EmptySeeds(opp,OppHole(endpt));
-			EmptySeeds(playing,endpt);
+			SetPit (opppit, 0);
+			SetPit (pit, 0);
 			Score(playing, oppseeds+1);
+			undo.captured = oppseeds;
 		}
 	}
+	undo.store = Score(playing) - undo.store;
+	return(myside ? endpt : pit - Pit(opp,0));  // Tell player where move ends
+}
 
-	//Display();			// Show game after move
-	return(endpt);			// Tell player where move ends
+// Seeds sown into pit of the cycle of 2N+1 pits (player's holes 0-N,
+// then opponent's 0 to N-1) when the player moves from hole
+static int CycleDrops ( int cycle, int movement, int seeds, int cycpit )
+{
+	int dist = (cycpit - movement + cycle) % cycle;  // Seeds to reach pit
+	if (dist == 0) dist = cycle;
+	return(seeds >= dist ? (seeds - dist)/cycle + 1 : 0);
+}
+
+// Where player's move would end, without moving
+template <int N, int S>
+int KalahGame<N,S>::MoveEnd ( int playing, int movement )
+{
+	int cycpit = (movement + Seeds(playing,movement)) % CYCLE;
+	return(cycpit < HOLES ? cycpit : cycpit - HOLES);
+}
+
+// Seeds player's move would capture, without moving
+template <int N, int S>
+int KalahGame<N,S>::MoveCaptures ( int playing, int movement )
+{
+	int seeds = Seeds(playing,movement);
+	int endpt = (movement + seeds) % CYCLE;
+
+	if ((seeds == 0) || (endpt >= N)) return(0);  // Not on own hole
+
+	int mine = (endpt == movement ? 0 : Seeds(playing,endpt));
+	if (mine + CycleDrops (CYCLE, movement, seeds, endpt) != 1) return(0);
+
+	int opphole = OppHole(endpt);
+	return(Seeds(Opponent(playing),opphole) + CycleDrops (CYCLE, movement, seeds, HOLES+opphole));
+}
+
+// Take back move exactly
+template <int N, int S>
+void KalahGame<N,S>::UnmakeMove ( MoveUndo &undo )
+{
+	int playing = (undo.pit < HOLES ? 1 : 2);
+	int opp = Opponent(playing);
+	int pit = undo.end;
+
+	if (undo.captured > 0) {	// Return captured seeds
+		SetPit (Pit(opp,OppHole(pit - Pit(playing,0))), undo.captured);
+		SetPit (pit, 1);
+		DropSeeds (playing, WELL, -(undo.captured+1));
+	}
+
+	SowSeeds (playing-1, undo.pit - Pit(playing,0), undo.seeds, -1);  // Pick sown seeds back up
+	SetPit (undo.pit, undo.seeds);	// Seeds back in hole
 }
 
 // Display game board
-void Game::Display ( )
+template <int N, int S>
+void KalahGame<N,S>::Display ( ostream &out )
 {
 	char alpha;
 	int s;
 
-	cout << "PLAYER 2" << endl;
-	cout << Score(2);
+	out << "PLAYER 2" << endl;
+	out << Score(2);
 	alpha = Hole1(2);
-	for (s = 5; s >= 0; s--) { 
-		cout << "\t" << alpha++ << "-" << Seeds(2,s);
+	for (s = N-1; s >= 0; s--) { 
+		out << "\t" << alpha++ << "-" << Seeds(2,s);
 	}
-	cout << endl;
+	out << endl;
 
 	alpha = Hole1(1);
-	for (s = 0; s < 6; s++) { 
-		cout << "\t" << alpha-- << "-" << Seeds(1,s);
+	for (s = 0; s < N; s++) { 
+		out << "\t" << alpha-- << "-" << Seeds(1,s);
 	}
-	cout << "\t" << Score(1) << endl;
-	cout << "PLAYER 1" << endl;
+	out << "\t" << Score(1) << endl;
+	out << "PLAYER 1" << endl;
 }
+
+// Every board variant
+#define GAME_VARIANT(n,s) template class KalahGame<n,s>;
+KALAH_VARIANTS(GAME_VARIANT)
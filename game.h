@@ -9,49 +9,158 @@
  *    ./kalah -d depth -1 player1.txt -2 player2.txt
  */
 
+#include <iostream>
+#include <cstring>
+#include <sys/time.h>
+
 using namespace std;
 
+double TimeSince ( struct timeval *starter );
+double ParseTime ( const char *arg );
+long MaxMemory ( );
 int Opponent ( int p );
 int ChooseHole ( int playing, char hole );
 char MoveHole ( int playing, int movement );
 
 const int INITSEEDS = 6;		// Seeds to start in holes
+const int HOLES = 7;			// Holes per player, score well last
+const int PITS = 2*HOLES;		// Pits on the packed board
+const int ALLSEEDS = 2*6*INITSEEDS;	// Seeds in play
+const int MAXCHAIN = ALLSEEDS+1;	// Longest chain of bonus moves
+const int MAXHOLES = 6;			// Most holes per player, any board
+
+// Boards built, Kalah(holes,seeds): holes per player to sow from and
+// seeds to start in each.  V(holes,seeds) is expanded for every board.
+#define KALAH_VARIANTS(V) \
+	V(4,3) V(4,4) V(4,5) V(4,6) \
+	V(5,3) V(5,4) V(5,5) V(5,6) \
+	V(6,3) V(6,4) V(6,5) V(6,6)
+
+// Board Kalah(holes,seeds) from holes,seeds, 0 if one of the boards built
+int ParseBoard ( const char *arg, int *holes, int *seeds );
+
+typedef unsigned long long HashKey;	// Position key
+
+// Moves of one turn: a move and the bonus moves after it, held inline
+// so the search never allocates
+class Moves {
+public:
+	inline Moves ( ) { count = 0; }
+	inline Moves ( const Moves &m ) { *this = m; }
+	inline Moves &operator= ( const Moves &m ) {
+		count = m.count;
+		memcpy (move, m.move, count);
+		return(*this);
+	}
+
+	inline size_t size ( ) const { return(count); }
+	inline char &operator[] ( size_t m ) { return(move[m]); }
+	inline void push_back ( char m ) { move[count++] = m; }
+	inline void clear ( ) { count = 0; }
+
+private:
+	int count;			// Moves held
+	char move[MAXCHAIN];		// Holes moved, as letters
+};
+
+// Record to take back a move
+struct MoveUndo {
+	unsigned char pit;		// Pit seeds were picked up from
+	unsigned char seeds;		// Seeds sown from it
+	unsigned char end;		// Pit where sowing ended
+	unsigned char captured;		// Opponent's seeds captured
+	unsigned char store;		// Seeds added to player's score well
+};
 
-// Kalah game position
-class Game {
+// Kalah game position on a board of N holes per player, S seeds to
+// start in each.  Sowing tables, keys and lap sizes are built for each
+// board at compile time.
+template <int N, int S>
+class KalahGame {
 public:
+	static const int WELL = N;		// Player's score well, after holes
+	static const int INITSEEDS = S;		// Seeds to start in holes
+	static const int HOLES = N+1;		// Holes per player, score well last
+	static const int PITS = 2*HOLES;	// Pits on the packed board
+	static const int ALLSEEDS = 2*N*S;	// Seeds in play
+	static const int CYCLE = 2*N+1;		// Pits one lap of sowing drops in
+
+	static_assert((N >= 1) && (N <= MAXHOLES), "holes fit move arrays");
+	static_assert(ALLSEEDS < 256, "every pit's seeds fit a byte");
+	static_assert(ALLSEEDS < MAXCHAIN, "bonus chains fit Moves");
+
 	// Init Kalah game
-	Game ( );
-	Game ( Game &b4 );
+	KalahGame ( );
+	KalahGame ( const int pits[PITS] );
+	KalahGame ( const KalahGame &b4 );
 
-	// How many games?
-	inline static int Nodes ( ) { return(nodes); }
+	inline int InfiniteScore ( ) { return(ALLSEEDS+1); }
 
-	inline int InfiniteScore ( ) { return((2*6*6)+1); }
+	// Letter of player's first hole, hole of letter, letter of hole
+	static inline char Hole1 ( int p ) { return(p == 1 ? 'a'+N-1 : 'A'); }
+	static inline int ChooseHole ( int playing, char hole ) {
+		if (hole == ' ') return(-1);
+		return(playing == 1 ? Hole1(1)-hole : N-1-(hole-Hole1(2)));
+	}
+	static inline char MoveHole ( int playing, int movement ) {
+		return(playing == 1 ? Hole1(1)-movement : Hole1(2)+N-1-movement);
+	}
 
 	// Player's score well
-	inline int Score ( int p ) { return(Seeds(p,6)); }
-	inline int Score ( int p, int s ) { return(DropSeeds(p,6,s)); }
+	inline int Score ( int p ) { return(Seeds(p,WELL)); }
+	inline int Score ( int p, int s ) { return(DropSeeds(p,WELL,s)); }
+
+	// Seeds still in holes
+	inline int SeedsInPlay ( ) { return(ALLSEEDS - Score(1) - Score(2)); }
 
 	// Moves allowed for player at this stage of the game
 	int MovesAllowed ( char allowed[], int playing );
 
 	// Player moves seeds from hole
 	int KalahMove ( int playing, int movement );
+	int KalahMove ( int playing, int movement, MoveUndo &undo );
+
+	// Player moves seeds from hole one seed at a time, to check
+	// KalahMove against
+	int ReferenceMove ( int playing, int movement, MoveUndo &undo );
+
+	// Same position, hash key included?
+	inline bool Same ( const KalahGame &g ) {
+		return((memcmp (holes, g.holes, sizeof(holes)) == 0) && (hash == g.hash));
+	}
+
+	// Where player's move would end, without moving
+	int MoveEnd ( int playing, int movement );
+
+	// Seeds player's move would capture, without moving
+	int MoveCaptures ( int playing, int movement );
+
+	// Take back move exactly
+	void UnmakeMove ( MoveUndo &undo );
 
 	// Seeds in player's hole
-	inline int Seeds ( int p, int h ) { return(holes[p-1][h]); }
+	inline int Seeds ( int p, int h ) { return(holes[Pit(p,h)]); }
 
 	// Empty player's hole
 	inline int EmptySeeds ( int p, int hole ) { 
-		int dump = holes[p-1][hole];	// Save seeds
-		holes[p-1][hole] = 0;		// No seeds left
+		int dump = holes[Pit(p,hole)];	// Save seeds
+		SetPit (Pit(p,hole), 0);	// No seeds left
 		return(dump);			// Return seeds
 	}
 
 	// Drop seeds in player's hole
 	inline int DropSeeds ( int p, int hole, int seeds ) {
-		return(holes[p-1][hole] += seeds);	// Add seeds
+		int pit = Pit(p,hole);
+		SetPit (pit, holes[pit] + seeds);  // Add seeds
+		return(holes[pit]);
+	}
+
+	// Position key with player p to move, bits mixed for table index
+	inline HashKey Hash ( int p ) {
+		HashKey key = (p == 1 ? hash : hash + sidekey);
+		key = (key ^ (key >> 33)) * 0xff51afd7ed558ccdULL;
+		key = (key ^ (key >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+		return(key ^ (key >> 33));
 	}
 
 	// Evaluate game as net score of player p
@@ -64,12 +173,47 @@ public:
 	int Gather ( int player );
 
 	// Display game board
-	void Display ( );
+	void Display ( ostream &out = cout );
 
 private:
-	int holes[2][7];		// Game holes for each player
+	// Packed board: player 1 holes 0-N, player 2 holes N+1 on, pad to
+	// 16.  Every pit holds at most ALLSEEDS seeds, so 8 bits suffice
+	// and the whole position copies as one 128-bit word.
+	alignas(16) unsigned char holes[16];
+
+	HashKey hash;			// Sum of seeds times pit keys
+
+	// Pit on packed board of player's hole
+	inline static int Pit ( int p, int h ) { return((p-1)*HOLES + h); }
 
-	static int nodes;		// Game nodes generated
+	// Opponent's hole opposite player's hole
+	inline static int OppHole ( int myhole ) { return(N-1 - myhole); }
+
+	// Set seeds in pit, keeping the hash key up to date
+	inline void SetPit ( int pit, int seeds ) {
+		hash += (HashKey)(seeds - holes[pit]) * pitkey[pit];
+		holes[pit] = seeds;
+	}
+
+	// Add seeds sown from player's hole, or take them back (sign -1)
+	void SowSeeds ( int side, int movement, int seeds, int sign );
+
+	// Hash key of pits from scratch
+	void Rehash ( );
+
+	// Generate keys
+	static bool KeysInit ( );
+
+	static HashKey pitkey[PITS];	// Key per pit, times seeds in it
+	static HashKey sidekey;		// Key for player 2 to move
+	static HashKey lapkey[2];	// Keys of a lap of sowing, per side
+	static HashKey restkey[2][N][CYCLE];  // Keys of pits after hole, per seeds
+	static bool keyinit;		// Keys generated
 };
 
+// Standard Kalah(6,6), played unless another board is asked for
+typedef KalahGame<6,6> Game;
+
+static_assert((Game::HOLES == HOLES) && (Game::ALLSEEDS == ALLSEEDS), "standard board");
+
 #endif
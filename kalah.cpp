@@ -5,156 +5,39 @@
  *
  * Usage:
  *    ./kalah -d depth -1 player1.txt -2 player2.txt
+ *    ./kalah -q -r games.kgr -d depth -1 player1.txt -2 player2.txt
+ *    ./kalah -k holes,seeds -d depth -1 player1.txt -2 player2.txt
+ *    ./kalah perft [-k holes,seeds] [-j threads] [-c] [-r boards] depth [player pits...]
  */
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <unistd.h>
 #include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <sys/time.h>
-#include <sys/resource.h>
+#include <thread>
+#include <vector>
 #include "game.h"
+#include "table.h"
+#include "endgame.h"
+#include "book.h"
+#include "stats.h"
 #include "player.h"
+#include "perft.h"
+#include "record.h"
+#include "engine.h"
 
 using namespace std;
 
 // Correct usage
 void Usage ( char *argv[] )
 {
-	cerr << "Usage: " << argv[0] << "-d depth -1 player1.txt -2 player2.txt" << endl;
-}
-
-typedef struct {
-	int depth;			// Depth
-	string algorithm1, evalfunc1;	// Player 1 options
-	string algorithm2, evalfunc2;	// Player 2 options
-} InputArgs;
-
-typedef struct {
-	int depth;			// Depth
-	char *file1, *file2;		// Player description files
-} CommandArgs;
-
-// Play Kalay Game
-class Kalah {
-public:
-	// Initialize Kalah game
-	Kalah ( CommandArgs args );
-	Kalah ( InputArgs args );
-
-	// Play Kalah game
-	void PlayKalah ( );
-
-	// Output Kalah statistics
-	void DispStats ( );
-
-private:
-	Player p1;			// Player 1
-	Player p2;			// Player 2
-	Game game;			// Game position
-	int depth;			// Search depth
-
-	int turn;			// Players take turns
-	int win;			// Who won
-	struct timeval starter;		// Start time
-
-	// Complete initialization of Kalah game
-	void KalahInit ( int d );
-};
-
-Kalah::Kalah ( CommandArgs args )
-	: p1(args.file1,1), p2(args.file2,2), game()
-{
-	KalahInit(args.depth);
-}
-
-Kalah::Kalah ( InputArgs args )
-	: p1(args.algorithm1,args.evalfunc1,1), p2(args.algorithm2,args.evalfunc2,2), game()
-{
-	KalahInit(args.depth);
-}
-
-// Complete initialization of Kalah game
-void Kalah::KalahInit ( int d )
-{
-	depth = d;
-
-	turn = 0;			// Starting
-	win = 0;			// Nobody won
-
-	struct timezone timezone;
-	if (gettimeofday (&starter, &timezone)) {
-		cerr << "ERROR: Unable to read system time." << endl;
-	}
-}
-
-// Play Kalah game
-void Kalah::PlayKalah ( )
-{
-	while (win <= 0) {		// Until game won
-		cout << "Game before turn " << (turn+1) << endl;
-		game.Display();
-
-		Player *pl = ((turn++ % 2) == 0 ? &p1 : &p2);	// Player turn
-		win = pl->TakeTurn (game, depth);
-		if (win < 0) {		// Take a loss
-			win = Opponent(pl->Who());
-		}
-
-		cout << "Game after turn " << turn << endl;
-		game.Display();
-		cout << endl;
-	}
-}
-
-inline double dbltime ( struct timeval *tim ) {
-	return(tim->tv_sec + tim->tv_usec/1000000.0);
-}
-
-// Elapsed time since start
-double TimeSince ( struct timeval *starter )
-{
-	struct timeval nowtime;
-	struct timezone timezone;
-
-	if (gettimeofday (&nowtime, &timezone) != 0) {
-		cerr << "ERROR: Unable to read system time." << endl;
-	}
-	return(dbltime(&nowtime) - dbltime(starter));
-}
-
-// How much memory did program use?
-long MaxMemory ( )
-{
-	struct rusage resources;	// Resource usage report
-
-	if (getrusage (RUSAGE_SELF, &resources) != 0) {
-		cerr << "ERROR: Unable to read resources." << endl;
-	}
-	return(resources.ru_maxrss);	// Max. resident size
-}
-
-// Output Kalah statistics
-void Kalah::DispStats ( )
-{
-	int myscore = game.Score(1);	// Watch for ties
-	int oppscore = game.Score(2);
-	cout << endl << "Game FINAL:" << endl;
-	game.Display();
-
-	if (myscore == oppscore) {
-		cout << "The game was TIED!" << endl << endl;
-	} else {
-		cout << "Player " << win << " WINS!" << endl << endl;
-	}
-	Player::Replay();
-	cout << endl;
-
-	cout << "Game played " << turn << " turns." << endl;
-	cout << "Game nodes generated: " << Game::Nodes() << endl;
-	cout << "Game nodes expanded: " << (Game::Nodes() - (Player::Records()+1)) << endl;
-	cout << "Game played in " << TimeSince(&starter) << " secs." << endl;
-	cout << "Max. memory usage: " << MaxMemory() << "k" << endl;
+	cerr << "Usage: " << argv[0] << " [-k holes,seeds] [-d depth] [-t movetime] [-T gametime] [-n nodes] [-j threads] [-e endgame.egdb] [-b opening.book] [-s stats.json] [-p] [-q] [-o moves.jsonl] [-r games.kgr] -1 player1.txt -2 player2.txt" << endl;
+	cerr << "       " << argv[0] << " perft [-k holes,seeds] [-j threads] [-c] [-r boards] depth [player pits...]" << endl;
 }
 
 // Reading arguments input by user
@@ -163,18 +46,18 @@ int PromptArguments ( InputArgs *inputs )
 	do {
 		cout << "What depth do you want the Kalah strategy to go? ";
 		cin >> inputs->depth;
-		if (!((inputs->depth == 2) || (inputs->depth == 4))) {
-			cerr << "Depths supported are 2 or 4." << endl;
+		if (!((inputs->depth >= 1) && (inputs->depth <= MAXDEPTH))) {
+			cerr << "Depths supported are 1 to " << MAXDEPTH << "." << endl;
 		}
-	} while (!((inputs->depth == 2) || (inputs->depth == 4)));
+	} while (!((inputs->depth >= 1) && (inputs->depth <= MAXDEPTH)));
 
 	do {
 		cout << "What is Player 1's search algorithm? " << endl;
 		cin >> inputs->algorithm1;
-		if (!((inputs->algorithm1 == ALGORITHMS[0]) || (inputs->algorithm1 == ALGORITHMS[1]))) {
-			cerr << "Algorithms are: " << ALGORITHMS[0] << " or " << ALGORITHMS[1] << "." << endl;
+		if (!((inputs->algorithm1 == ALGORITHMS[0]) || (inputs->algorithm1 == ALGORITHMS[1]) || (inputs->algorithm1 == ALGORITHMS[2]))) {
+			cerr << "Algorithms are: " << ALGORITHMS[0] << ", " << ALGORITHMS[1] << " or " << ALGORITHMS[2] << "." << endl;
 		};
-	} while (!((inputs->algorithm1 == ALGORITHMS[0]) || (inputs->algorithm1 == ALGORITHMS[1])));
+	} while (!((inputs->algorithm1 == ALGORITHMS[0]) || (inputs->algorithm1 == ALGORITHMS[1]) || (inputs->algorithm1 == ALGORITHMS[2])));
 
 	do {
 		cout << "What is Player 1's evaluation function? " << endl;
@@ -187,10 +70,10 @@ int PromptArguments ( InputArgs *inputs )
 	do {
 		cout << "What is Player 2's search algorithm? " << endl;
 		cin >> inputs->algorithm2;
-		if (!((inputs->algorithm2 == ALGORITHMS[0]) || (inputs->algorithm2 == ALGORITHMS[1]))) {
-			cerr << "Algorithms are: " << ALGORITHMS[0] << " or " << ALGORITHMS[1] << "." << endl;
+		if (!((inputs->algorithm2 == ALGORITHMS[0]) || (inputs->algorithm2 == ALGORITHMS[1]) || (inputs->algorithm2 == ALGORITHMS[2]))) {
+			cerr << "Algorithms are: " << ALGORITHMS[0] << ", " << ALGORITHMS[1] << " or " << ALGORITHMS[2] << "." << endl;
 		};
-	} while (!((inputs->algorithm2 == ALGORITHMS[0]) || (inputs->algorithm2 == ALGORITHMS[1])));
+	} while (!((inputs->algorithm2 == ALGORITHMS[0]) || (inputs->algorithm2 == ALGORITHMS[1]) || (inputs->algorithm2 == ALGORITHMS[2])));
 
 	do {
 		cout << "What is Player 2's evaluation function? " << endl;
@@ -205,13 +88,33 @@ int PromptArguments ( InputArgs *inputs )
 // Reading arguments from the command line
 int CommandArguments ( int argc, char *argv[], CommandArgs *cmdargs )
 {
+	SearchLimits *limits = &cmdargs->limits;
 	int opt;
 
-	cmdargs->depth = -1;		// No values
+	limits->depth = -1;		// No values
+	limits->movetime = limits->gametime = 0;
+	limits->nodes = 0;
+	limits->threads = 1;
 	cmdargs->file1 = cmdargs->file2 = NULL;
-
-	while ((opt = getopt (argc, argv, "1:2:d:")) != -1) {
+	cmdargs->endgame = NULL;
+	cmdargs->book = NULL;
+	cmdargs->stats = NULL;
+	cmdargs->quiet = 0;
+	cmdargs->ponder = 0;
+	cmdargs->records = NULL;
+	cmdargs->games = NULL;
+	cmdargs->holes = 6;		// Standard Kalah(6,6)
+	cmdargs->seeds = INITSEEDS;
+
+	while ((opt = getopt (argc, argv, "1:2:d:t:T:n:j:e:b:s:pqo:r:k:")) != -1) {
 		switch (opt) {
+		case 'k':		// Board
+			if (ParseBoard (optarg, &cmdargs->holes, &cmdargs->seeds)) {
+				cerr << "Board " << optarg << " must be holes,seeds from 4,3 to 6,6." << endl;
+				return(2);
+			}
+			break;
+
 		case '1':		// Player 1
 			cmdargs->file1 = optarg;
 			break;
@@ -221,17 +124,81 @@ int CommandArguments ( int argc, char *argv[], CommandArgs *cmdargs )
 			break;
 
 		case 'd':		// Depth
-			cmdargs->depth = atoi(optarg);
+			limits->depth = atoi(optarg);
+			if (!((limits->depth >= 1) && (limits->depth <= MAXDEPTH))) {
+				cerr << "Depth " << optarg << " must be 1 to " << MAXDEPTH << "." << endl;
+				return(2);
+			}
+			break;
+
+		case 't':		// Time per move
+			limits->movetime = ParseTime(optarg);
+			if (limits->movetime <= 0) {
+				cerr << "Move time " << optarg << " must be like 250ms or 2s." << endl;
+				return(2);
+			}
+			break;
+
+		case 'T':		// Game clock per player
+			limits->gametime = ParseTime(optarg);
+			if (limits->gametime <= 0) {
+				cerr << "Game time " << optarg << " must be like 500ms or 60s." << endl;
+				return(2);
+			}
+			break;
+
+		case 'n':		// Nodes per move
+			limits->nodes = atol(optarg);
+			if (limits->nodes <= 0) {
+				cerr << "Nodes " << optarg << " must be more than 0." << endl;
+				return(2);
+			}
+			break;
+
+		case 'j':		// Search threads
+			limits->threads = atoi(optarg);
+			if (!((limits->threads >= 1) && (limits->threads <= MAXTHREADS))) {
+				cerr << "Threads " << optarg << " must be 1 to " << MAXTHREADS << "." << endl;
+				return(2);
+			}
+			break;
+
+		case 'e':		// Endgame database
+			cmdargs->endgame = optarg;
+			break;
+
+		case 'b':		// Opening book
+			cmdargs->book = optarg;
+			break;
+
+		case 's':		// Search statistics
+			cmdargs->stats = optarg;
+			break;
+
+		case 'p':		// Ponder on opponent's turn
+			cmdargs->ponder = 1;
+			break;
+
+		case 'q':		// Quiet, move records only
+			cmdargs->quiet = 1;
+			break;
+
+		case 'o':		// Move records file
+			cmdargs->records = optarg;
+			break;
+
+		case 'r':		// Binary game records file
+			cmdargs->games = optarg;
 			break;
 
 		default:
-			cerr << "Unknown option " << opt << endl;
+			Usage(argv);
 			return(1);
 		}
 	}
 
-	if (!((cmdargs->depth == 2) || (cmdargs->depth == 4))) {
-		cerr << "Depth " << cmdargs->depth << " must be 2 or 4." << endl;
+	if ((limits->depth < 0) && (limits->movetime <= 0) && (limits->gametime <= 0) && (limits->nodes <= 0)) {
+		cerr << "Depth, time or nodes must be given." << endl;
 		return(2);
         }
 
@@ -242,28 +209,171 @@ int CommandArguments ( int argc, char *argv[], CommandArgs *cmdargs )
 	return(0);
 }
 
-int main ( int argc, char *argv[] )
+template <class G>
+int PerftBoard ( int argc, char *argv[], int threads, int check, long boards );
+
+// Count game tree positions from start or given position
+int PerftKalah ( int argc, char *argv[] )
 {
-	Kalah *kalah;			// Kalah game
+	int threads = thread::hardware_concurrency();
+	int check = 0;			// Check sowing on every move?
+	long boards = 0;		// Random boards to check sowing on
+	int holes = 6, seeds = INITSEEDS;  // Standard board
+	int opt;
 
-	if (argc == 1) {		// No arguments/
-		InputArgs inputs;
-		if (PromptArguments (&inputs)) {
-			cerr << "ERROR: Illegal arguments input." << endl;
+	optind = 2;			// After perft
+	while ((opt = getopt (argc, argv, "k:j:cr:")) != -1) {
+		switch (opt) {
+		case 'k':		// Board
+			if (ParseBoard (optarg, &holes, &seeds)) {
+				cerr << "Board " << optarg << " must be holes,seeds from 4,3 to 6,6." << endl;
+				return(2);
+			}
+			break;
+
+		case 'j':		// Counting threads
+			threads = atoi(optarg);
+			if (!((threads >= 1) && (threads <= MAXTHREADS))) {
+				cerr << "Threads " << optarg << " must be 1 to " << MAXTHREADS << "." << endl;
+				return(2);
+			}
+			break;
+
+		case 'c':		// Check sowing
+			check = 1;
+			break;
+
+		case 'r':		// Random boards
+			boards = atol(optarg);
+			if (boards <= 0) {
+				cerr << "Boards " << optarg << " must be more than 0." << endl;
+				return(2);
+			}
+			break;
+
+		default:
+			Usage(argv);
 			return(1);
 		}
-		kalah = new Kalah(inputs);
+	}
+	if (threads < 1) threads = 1;
+
+#define PERFT_VARIANT(n,s) \
+	if ((holes == n) && (seeds == s)) { \
+		return(PerftBoard<KalahGame<n,s> > (argc, argv, threads, check, boards)); \
+	}
+	KALAH_VARIANTS(PERFT_VARIANT)
+	return(2);
+}
+
+// Count game tree positions on board G, after options
+template <class G>
+int PerftBoard ( int argc, char *argv[], int threads, int check, long boards )
+{
+	if (boards > 0) {		// Sowing on random boards
+		long long moves;
+		long long differ = SowingCheck<G> (boards, &moves);
+		cout << "Sowing check on " << boards << " random boards: " << moves << " moves, "
+		     << differ << " differ." << endl;
+		if (differ > 0) return(3);
+	}
 
-	} else {			// Command line
-		CommandArgs cmdargs;
-		if (CommandArguments (argc, argv, &cmdargs)) {
-			cerr << "ERROR: Illegal arguments in files." << endl;
+	if (optind >= argc) {
+		Usage(argv);
+		return(1);
+	}
+	int depth = atoi(argv[optind++]);
+	if (!((depth >= 1) && (depth <= MAXDEPTH))) {
+		cerr << "Depth must be 1 to " << MAXDEPTH << "." << endl;
+		return(2);
+	}
+
+	G game;				// Start position
+	int playing = 1;
+	if (optind < argc) {		// Player to move and pits
+		int pits[G::PITS];
+		int total = 0;
+		int p;
+		if (argc - optind != 1 + G::PITS) {
+			cerr << "Position must be player to move and " << G::PITS << " pits." << endl;
+			return(2);
+		}
+		playing = atoi(argv[optind++]);
+		for (p = 0; p < G::PITS; p++) {
+			pits[p] = atoi(argv[optind++]);
+			if (pits[p] < 0) break;
+			total += pits[p];
+		}
+		if ((p < G::PITS) || (total != G::ALLSEEDS) || (playing < 1) || (playing > 2)) {
+			cerr << "Position must have " << G::ALLSEEDS << " seeds and player 1 or 2 to move." << endl;
 			return(2);
 		}
-		kalah = new Kalah(cmdargs);
+		game = G(pits);
+	}
+
+	vector<PerftCounts> counts;
+	struct timeval starter;
+	gettimeofday (&starter, NULL);
+	Perft (game, playing, depth, threads, check, counts);
+	double secs = TimeSince(&starter);
+
+	long long total = 0;
+	int d;
+	cout << "depth\tnodes\tbonus\tcaptures\tterminals" << endl;
+	for (d = 1; d <= depth; d++) {
+		cout << d << "\t" << counts[d].nodes << "\t" << counts[d].bonus << "\t"
+		     << counts[d].captures << "\t" << counts[d].terminals << endl;
+		total += counts[d].nodes;
+	}
+	if (check) {
+		long long differ = 0;
+		for (d = 1; d <= depth; d++) {
+			differ += counts[d].differ;
+		}
+		cout << "Sowing check: " << total << " moves, " << differ << " differ." << endl;
+		if (differ > 0) return(3);
 	}
+	cout << "Perft " << depth << " counted " << total << " nodes on " << threads << " threads in "
+	     << secs << " secs, " << (long long)(secs > 0 ? total / secs : 0) << " nodes/sec." << endl;
+	return(0);
+}
 
+// Play Kalah game and output its results
+template <class G>
+int PlayBoard ( Engine<G> *kalah )
+{
 	kalah->PlayKalah();		// Play Kalah game
 	kalah->DispStats();		// Output statistics	
+	kalah->WriteStats();
+	kalah->WriteGame();
+	delete kalah;
 	return(0);
 }
+
+int main ( int argc, char *argv[] )
+{
+	if ((argc > 1) && (strcmp (argv[1], "perft") == 0)) {
+		return(PerftKalah (argc, argv));
+	}
+
+	if (argc == 1) {		// No arguments/
+		InputArgs inputs;
+		if (PromptArguments (&inputs)) {
+			cerr << "ERROR: Illegal arguments input." << endl;
+			return(1);
+		}
+		return(PlayBoard (new Engine<Game>(inputs)));
+	}
+
+	CommandArgs cmdargs;		// Command line
+	if (CommandArguments (argc, argv, &cmdargs)) {
+		cerr << "ERROR: Illegal arguments in files." << endl;
+		return(2);
+	}
+#define KALAH_VARIANT(n,s) \
+	if ((cmdargs.holes == n) && (cmdargs.seeds == s)) { \
+		return(PlayBoard (new Engine<KalahGame<n,s> >(cmdargs))); \
+	}
+	KALAH_VARIANTS(KALAH_VARIANT)
+	return(2);
+}
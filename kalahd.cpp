@@ -0,0 +1,615 @@
+
+/*
+ * Compile:
+ *    make kalahd
+ *
+ * Usage:
+ *    ./kalahd [-s kalahd.sock] [-j workers] [-S slice] [-d depth] [-a algorithm] [-f evalfunc] [-h hashsize] [-q quiescence] [-e endgame.egdb]
+ *
+ * Requests, one a line, answered in the order searches finish:
+ *    id [holes,seeds] player pits... [d depth] [t movetime] [n nodes]
+ *    id cancel
+ *    id moves score depth nodes secs line
+ *    id gameover netscore
+ *    id error message
+ */
+
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <condition_variable>
+#include "game.h"
+#include "table.h"
+#include "endgame.h"
+#include "book.h"
+#include "stats.h"
+#include "player.h"
+#include "task.h"
+
+using namespace std;
+
+const int DAEMONDEPTH = 10;		// Default depth when request sets no limit
+
+// Correct usage
+void Usage ( char *argv[] )
+{
+	cerr << "Usage: " << argv[0] << " [-s kalahd.sock] [-j workers] [-S slice] [-d depth] [-a algorithm] [-f evalfunc] [-h hashsize] [-q quiescence] [-e endgame.egdb]" << endl;
+}
+
+// How every worker searches
+typedef struct {
+	string algorithm;		// Strategy algorithm
+	string evalfunc;		// Evaluation function
+	int hashsize;			// Table megabytes per board and player to move
+	int quiesce;			// Quiescence plies, 0 none
+	int depth;			// Depth when request sets no limit
+	EndgameDB *endgame;		// Solved endgames, shared
+} DaemonConfig;
+
+// Position to search and its limits
+typedef struct {
+	string id;			// Echoed in reply
+	int holes, seeds;		// Board, Kalah(holes,seeds)
+	int playing;			// Player to move
+	vector<int> pits;		// Pits as in bench.txt
+	SearchLimits limits;		// Depth, time and nodes
+} Request;
+
+// Connection requests are read from and replies written to.  Replies
+// from different workers are written whole, one at a time.
+class Client {
+public:
+	Client ( int i, int o, int own );
+	~Client ( );
+
+	// Next request line, zero at end
+	int ReadLine ( string &line );
+
+	// Write reply line
+	void Reply ( const string &line );
+
+private:
+	FILE *in;			// Requests
+	int out;			// Replies
+	int ownfd;			// Close connection when done?
+	mutex writing;			// One reply at a time
+};
+
+Client::Client ( int i, int o, int own )
+{
+	in = fdopen (i, "r");
+	out = o;
+	ownfd = own;
+}
+
+Client::~Client ( )
+{
+	if (ownfd && (in != NULL)) fclose (in);	// Closes reply side too
+}
+
+// Next request line, zero at end
+int Client::ReadLine ( string &line )
+{
+	char buf[1024];
+
+	if (in == NULL) return(0);
+	line.clear();
+	while (fgets (buf, sizeof(buf), in) != NULL) {
+		line += buf;
+		if (line[line.size()-1] == '\n') {
+			line.erase(line.size()-1);
+			if ((line.size() > 0) && (line[line.size()-1] == '\r')) line.erase(line.size()-1);
+			return(1);
+		}
+	}
+	return(line.size() > 0);	// Last line without newline
+}
+
+// Write reply line; a client gone away is not an error
+void Client::Reply ( const string &line )
+{
+	string whole = line + "\n";
+	size_t done = 0;
+
+	lock_guard<mutex> hold(writing);
+	while (done < whole.size()) {
+		ssize_t n = write (out, whole.data() + done, whole.size() - done);
+		if (n <= 0) return;
+		done += n;
+	}
+}
+
+// Parse request line, or set error
+int ParseRequest ( const string &line, int depth, Request &req, string &error )
+{
+	istringstream in(line);
+	vector<string> tokens;
+	string token;
+	size_t t = 0;
+
+	while (in >> token) tokens.push_back(token);
+	req.id = (tokens.size() > 0 ? tokens[0] : "-");
+	req.holes = 6;			// Standard Kalah(6,6)
+	req.seeds = INITSEEDS;
+	req.pits.clear();
+	req.limits.depth = -1;
+	req.limits.movetime = req.limits.gametime = 0;
+	req.limits.nodes = 0;
+	req.limits.threads = 1;		// Workers are the threads
+
+	if (++t >= tokens.size()) {
+		error = "missing position";
+		return(1);
+	}
+	if (tokens[t].find(',') != string::npos) {
+		if (ParseBoard (tokens[t].c_str(), &req.holes, &req.seeds)) {
+			error = "board must be holes,seeds from 4,3 to 6,6";
+			return(1);
+		}
+		t++;
+	}
+	if ((t >= tokens.size()) || ((tokens[t] != "1") && (tokens[t] != "2"))) {
+		error = "player to move must be 1 or 2";
+		return(1);
+	}
+	req.playing = atoi(tokens[t++].c_str());
+	while ((t < tokens.size()) && isdigit(tokens[t][0])) {
+		req.pits.push_back(atoi(tokens[t++].c_str()));
+	}
+
+	for (; t < tokens.size(); t++) {	// Limits, letter and value as d10 or d 10
+		char limit = tokens[t][0];
+		const char *value = tokens[t].c_str() + 1;
+		if ((*value == '\0') && (t+1 < tokens.size())) {
+			value = tokens[++t].c_str();
+		}
+		switch (limit) {
+		case 'd':		// Depth
+			req.limits.depth = atoi(value);
+			if (!((req.limits.depth >= 1) && (req.limits.depth <= MAXDEPTH))) {
+				error = "depth must be 1 to " + to_string(MAXDEPTH);
+				return(1);
+			}
+			break;
+
+		case 't':		// Time per move
+			req.limits.movetime = ParseTime(value);
+			if (req.limits.movetime <= 0) {
+				error = "move time must be like 250ms or 2s";
+				return(1);
+			}
+			break;
+
+		case 'n':		// Nodes per move
+			req.limits.nodes = atol(value);
+			if (req.limits.nodes <= 0) {
+				error = "nodes must be more than 0";
+				return(1);
+			}
+			break;
+
+		default:
+			error = string("unknown limit ") + limit;
+			return(1);
+		}
+	}
+	if ((req.limits.depth < 0) && (req.limits.movetime <= 0) && (req.limits.nodes <= 0)) {
+		req.limits.depth = depth;
+	}
+	return(0);
+}
+
+// Request being searched, with where to reply
+//
+// The search is a task on the request's board, made when a worker
+// first takes the request.
+typedef struct {
+	shared_ptr<Client> client;	// Reply to
+	Request req;			// Position and limits
+	TransTable *table;		// Shared by its board and player to move
+	void *search;			// BoardSearch on its board, NULL not begun
+	atomic<int> cancelled;		// Client asked to stop it, seen by its task
+} Job;
+
+// Search of a request on board G
+template <class G>
+struct BoardSearch {
+	KalahPlayer<G> player;		// Searches in the shared table
+	SearchTask<G> task;		// Player's search, resumed in slices
+	struct timeval starter;		// When search began
+
+	BoardSearch ( G game, Request &req, DaemonConfig &config, TransTable *table, atomic<int> *cancelled )
+		: player(config.algorithm, config.evalfunc, req.playing, 0, 0, config.quiesce),
+		  task(player, game, req.limits, cancelled) {
+		player.ShareTable(table);
+		player.SetEndgame(config.endgame);
+		gettimeofday (&starter, NULL);
+	}
+};
+
+// Run job's search on board G for a slice, nonzero once it has replied
+template <class G>
+int StepSearch ( Job &job, DaemonConfig &config, double slice )
+{
+	ostringstream reply;
+	size_t p;
+
+	reply << job.req.id << " ";
+	if (job.search == NULL) {	// Check position before searching it
+		int total = 0;
+		if (job.req.pits.size() != (size_t)G::PITS) {
+			reply << "error position must be player and " << G::PITS << " pits";
+			job.client->Reply (reply.str());
+			return(1);
+		}
+		for (p = 0; p < job.req.pits.size(); p++) {
+			total += job.req.pits[p];
+		}
+		if (total != G::ALLSEEDS) {
+			reply << "error position must have " << G::ALLSEEDS << " seeds";
+			job.client->Reply (reply.str());
+			return(1);
+		}
+		G game(&job.req.pits[0]);
+		char allowed[MAXHOLES];
+		if (game.MovesAllowed (allowed, job.req.playing) == 0) {  // Nothing to search
+			int opp = Opponent(job.req.playing);
+			game.Score(opp, game.Gather(opp));
+			reply << "gameover " << game.NetScore(job.req.playing);
+			job.client->Reply (reply.str());
+			return(1);
+		}
+		job.search = new BoardSearch<G>(game, job.req, config, job.table, &job.cancelled);
+	}
+
+	BoardSearch<G> *search = (BoardSearch<G> *)job.search;
+	if (!search->task.Resume (slice)) return(0);	// Suspended
+
+	Moves movements;
+	int score = search->task.Best (movements);
+	if (movements.size() == 0) {	// Stopped in first depth
+		reply << "-";
+	}
+	for (p = 0; p < movements.size(); p++) {
+		reply << movements[p];
+	}
+	reply << " " << score << " " << search->task.Depth() << " " << search->player.Context().Nodes()
+	      << " " << TimeSince(&search->starter) << " ";
+	if (search->player.LineLength() == 0) {
+		reply << "-";
+	}
+	int t;
+	for (t = 0; t < search->player.LineLength(); t++) {
+		reply << search->player.LineMove(t);
+	}
+	job.client->Reply (reply.str());
+	delete search;
+	job.search = NULL;
+	return(1);
+}
+
+// Run job's search on its board for a slice, nonzero once it has replied
+int StepBoard ( Job &job, DaemonConfig &config, double slice )
+{
+#define STEP_VARIANT(n,s) \
+	if ((job.req.holes == n) && (job.req.seeds == s)) { \
+		return(StepSearch<KalahGame<n,s> > (job, config, slice)); \
+	}
+	KALAH_VARIANTS(STEP_VARIANT)
+	job.client->Reply (job.req.id + " error board not built");
+	return(1);
+}
+
+// Workers searching requests from every client
+//
+// Every search is a task, and workers take turns with them: a worker
+// runs the task at the front of its queue for a slice of time and puts
+// it back at the end if it is not done.  A task stays with the worker
+// that started it, as its stack may hold that thread's state.  Workers
+// take new requests when idle, or in turn when none is, so long searches
+// share the workers with short ones instead of holding them, and no more
+// threads search than there are workers.  Searches of the same board and player
+// to move share one table, so it stays warm from one request to the
+// next whichever worker takes them.  Clients can send requests without
+// waiting for replies, and replies carry the request id.
+class AnalysisPool {
+public:
+	AnalysisPool ( DaemonConfig &c, int threads, double s );
+	~AnalysisPool ( );
+
+	// Queue request for the next free worker
+	void Submit ( shared_ptr<Client> client, Request &req );
+
+	// Stop client's search with id, keeping its last depth; zero if none
+	int Cancel ( Client *client, const string &id );
+
+	// Answer requests queued, then stop workers
+	void Finish ( );
+
+private:
+	DaemonConfig config;		// How workers search
+	double slice;			// Seconds a search runs before its turn ends
+	deque<Job *> jobs;		// Searches waiting for a worker
+	int idle;			// Workers with no searches
+	list<Job *> active;		// Searches not yet answered
+	map<int, TransTable *> tables;	// By board and player to move
+	mutex lock;			// Guards all of the above
+	condition_variable ready;	// Job queued or finishing
+	int finishing;			// No more requests coming
+	vector<thread> workers;		// Search threads
+
+	// Search requests until finished
+	void Work ( );
+};
+
+AnalysisPool::AnalysisPool ( DaemonConfig &c, int threads, double s )
+{
+	int t;
+
+	config = c;
+	slice = s;
+	idle = 0;
+	finishing = 0;
+	for (t = 0; t < threads; t++) {
+		workers.push_back(thread(&AnalysisPool::Work, this));
+	}
+}
+
+AnalysisPool::~AnalysisPool ( )
+{
+	map<int, TransTable *>::iterator t;
+	for (t = tables.begin(); t != tables.end(); t++) {
+		delete t->second;
+	}
+}
+
+// Queue request for the next free worker
+void AnalysisPool::Submit ( shared_ptr<Client> client, Request &req )
+{
+	Job *job = new Job;
+	job->client = client;
+	job->req = req;
+	job->search = NULL;
+	job->cancelled = 0;
+
+	lock_guard<mutex> hold(lock);
+	int key = 2 * (100 * req.holes + req.seeds) + req.playing - 1;
+	if (tables.count(key) == 0) {	// First request for board and player
+		tables[key] = new TransTable(config.hashsize);
+	}
+	job->table = tables[key];
+	jobs.push_back(job);
+	active.push_back(job);
+	ready.notify_one();
+}
+
+// Stop client's search with id, keeping its last depth; zero if none
+int AnalysisPool::Cancel ( Client *client, const string &id )
+{
+	list<Job *>::iterator j;
+	int found = 0;
+
+	lock_guard<mutex> hold(lock);
+	for (j = active.begin(); j != active.end(); j++) {
+		if (((*j)->client.get() == client) && ((*j)->req.id == id)) {
+			(*j)->cancelled = 1;
+			found = 1;
+		}
+	}
+	return(found);
+}
+
+// Answer requests queued, then stop workers
+void AnalysisPool::Finish ( )
+{
+	size_t t;
+
+	{
+		lock_guard<mutex> hold(lock);
+		finishing = 1;
+		ready.notify_all();
+	}
+	for (t = 0; t < workers.size(); t++) {
+		workers[t].join();
+	}
+}
+
+// Search requests until finished
+void AnalysisPool::Work ( )
+{
+	deque<Job *> mine;		// Searches started here, run in turn
+
+	for (;;) {
+		{
+			unique_lock<mutex> hold(lock);
+			if (mine.empty()) {
+				idle++;
+				ready.wait(hold, [this] { return(finishing || !jobs.empty()); });
+				idle--;
+				if (jobs.empty()) break;	// Finishing
+			}
+			if (!jobs.empty() && (mine.empty() || (idle == 0))) {
+				mine.push_front(jobs.front());	// Starts next
+				jobs.pop_front();
+			}
+		}
+
+		Job *job = mine.front();
+		mine.pop_front();
+		if (!StepBoard (*job, config, slice)) {
+			mine.push_back(job);	// Back of the queue for another slice
+			continue;
+		}
+
+		lock_guard<mutex> hold(lock);
+		active.remove(job);
+		delete job;
+	}
+}
+
+// Read client's requests and queue them, answering bad ones at once
+void Serve ( shared_ptr<Client> client, AnalysisPool *pool, int depth )
+{
+	string line;
+
+	while (client->ReadLine (line)) {
+		size_t start = line.find_first_not_of(" \t");
+		if ((start == string::npos) || (line[start] == '#')) continue;	// Blank or comment
+
+		Request req;
+		string error;
+		istringstream words(line);
+		string id, command;
+		words >> id >> command;
+		if (command == "cancel") {	// Stop search, reply with its last depth
+			if (!pool->Cancel (client.get(), id)) {
+				client->Reply (id + " error no search to cancel");
+			}
+		} else if (ParseRequest (line, depth, req, error)) {
+			client->Reply (req.id + " error " + error);
+		} else {
+			pool->Submit (client, req);
+		}
+	}
+}
+
+// Listen on Unix socket, serving each client on its own reader thread
+int Listen ( const char *path, AnalysisPool *pool, int depth )
+{
+	struct sockaddr_un addr;
+	int fd = socket (AF_UNIX, SOCK_STREAM, 0);
+
+	memset (&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if ((fd < 0) || (strlen (path) >= sizeof(addr.sun_path))) {
+		cerr << "ERROR: Unable to listen on " << path << "." << endl;
+		return(3);
+	}
+	strcpy (addr.sun_path, path);
+	unlink (path);			// Socket left by an earlier daemon
+	if ((bind (fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (listen (fd, SOMAXCONN) != 0)) {
+		cerr << "ERROR: Unable to listen on " << path << "." << endl;
+		close (fd);
+		return(3);
+	}
+
+	for (;;) {
+		int conn = accept (fd, NULL, NULL);
+		if (conn < 0) continue;
+		shared_ptr<Client> client(new Client(conn, conn, 1));
+		thread(Serve, client, pool, depth).detach();
+	}
+	return(0);
+}
+
+int main ( int argc, char *argv[] )
+{
+	DaemonConfig config;
+	EndgameDB endgame;		// Solved endgames
+	char *socketpath = NULL;	// Unix socket, else stdin and stdout
+	int threads = thread::hardware_concurrency();
+	double slice = TASKSLICE;	// Seconds a search runs before its turn ends
+	int opt;
+
+	config.algorithm = ALGORITHMS[2];	// Principal variation search
+	config.evalfunc = EVALFUNCS[0];
+	config.hashsize = HASHSIZE;
+	config.quiesce = 0;
+	config.depth = DAEMONDEPTH;
+	config.endgame = NULL;
+
+	while ((opt = getopt (argc, argv, "s:j:S:d:a:f:h:q:e:")) != -1) {
+		switch (opt) {
+		case 's':		// Unix socket
+			socketpath = optarg;
+			break;
+
+		case 'j':		// Workers
+			threads = atoi(optarg);
+			break;
+
+		case 'S':		// Time slice
+			slice = ParseTime(optarg);
+			if (slice <= 0) {
+				cerr << "Slice " << optarg << " must be like 10ms." << endl;
+				return(2);
+			}
+			break;
+
+		case 'd':		// Default depth
+			config.depth = atoi(optarg);
+			if (!((config.depth >= 1) && (config.depth <= MAXDEPTH))) {
+				cerr << "Depth " << optarg << " must be 1 to " << MAXDEPTH << "." << endl;
+				return(2);
+			}
+			break;
+
+		case 'a':		// Algorithm
+			config.algorithm = optarg;
+			if ((config.algorithm != ALGORITHMS[0]) && (config.algorithm != ALGORITHMS[1]) && (config.algorithm != ALGORITHMS[2])) {
+				cerr << "Algorithms are: " << ALGORITHMS[0] << ", " << ALGORITHMS[1] << " or " << ALGORITHMS[2] << "." << endl;
+				return(2);
+			}
+			break;
+
+		case 'f':		// Evaluation function
+			config.evalfunc = optarg;
+			if ((config.evalfunc != EVALFUNCS[0]) && (config.evalfunc != EVALFUNCS[1])) {
+				cerr << "Evaluation functions are: " << EVALFUNCS[0] << " or " << EVALFUNCS[1] << "." << endl;
+				return(2);
+			}
+			break;
+
+		case 'h':		// Table megabytes
+			config.hashsize = atoi(optarg);
+			if (config.hashsize < 0) {
+				cerr << "Hash size " << optarg << " must be 0 or more." << endl;
+				return(2);
+			}
+			break;
+
+		case 'q':		// Quiescence plies
+			config.quiesce = atoi(optarg);
+			if (!((config.quiesce >= 0) && (config.quiesce <= QUIESCEPLIES))) {
+				cerr << "Quiescence " << optarg << " must be 0 to " << QUIESCEPLIES << "." << endl;
+				return(2);
+			}
+			break;
+
+		case 'e':		// Endgame database
+			if (endgame.Open (optarg) == 0) {
+				config.endgame = &endgame;
+			}
+			break;
+
+		default:
+			Usage(argv);
+			return(1);
+		}
+	}
+	if (threads < 1) threads = 1;
+	signal (SIGPIPE, SIG_IGN);	// Clients may leave before their replies
+
+	AnalysisPool pool(config, threads, slice);
+	if (socketpath != NULL) {
+		return(Listen (socketpath, &pool, config.depth));
+	}
+	Serve (shared_ptr<Client>(new Client(0, 1, 0)), &pool, config.depth);
+	pool.Finish();			// Answer the rest, then exit
+	return(0);
+}
@@ -0,0 +1,227 @@
+
+/*
+ * Compile:
+ *    make mkbook
+ *
+ * Usage:
+ *    ./mkbook [-p plies] [-d depth] [-a algorithm] [-f evalfunc] [-j threads] -o kalah.book
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <unordered_set>
+#include "game.h"
+#include "table.h"
+#include "endgame.h"
+#include "book.h"
+#include "stats.h"
+#include "player.h"
+
+using namespace std;
+
+const int BOOKPLIES = 4;		// Default turns from start
+const int BOOKDEPTH = 14;		// Default depth searched
+
+// Correct usage
+void Usage ( char *argv[] )
+{
+	cerr << "Usage: " << argv[0] << " [-p plies] [-d depth] [-a algorithm] [-f evalfunc] [-j threads] -o kalah.book" << endl;
+}
+
+// Position in book with player to move
+typedef struct {
+	Game game;			// Position
+	int playing;			// Player to move
+} BookPosition;
+
+// Add positions after every turn player can take, bonus moves included
+void NextTurns ( Game &game, int playing, vector<BookPosition> &next, unordered_set<HashKey> &seen )
+{
+	char allowed[6];		// Moves allowed
+	int moves = game.MovesAllowed (allowed, playing);
+	int m;
+
+	for (m = 0; m < moves; m++) {
+		MoveUndo undo;
+		int endpt = game.KalahMove (playing, ChooseHole (playing, allowed[m]), undo);
+		char bonus[6];
+		if ((endpt == 6) && (game.MovesAllowed (bonus, playing) > 0)) {
+			NextTurns (game, playing, next, seen);  // Bonus move
+		} else {
+			int opp = Opponent(playing);
+			if (seen.insert(game.Hash(opp)).second) {
+				BookPosition pos = { game, opp };
+				next.push_back(pos);
+			}
+		}
+		game.UnmakeMove (undo);
+	}
+}
+
+// Search book positions on one thread, taking the next from shared counter
+void SearchBook ( vector<BookPosition> *positions, vector<BookEntry> *entries,
+		  atomic<long> *next, string algorithm, string evalfunc, int depth )
+{
+	Player *players[2] = { NULL, NULL };
+	long p;
+
+	while ((p = (*next)++) < (long)positions->size()) {
+		BookPosition *pos = &(*positions)[p];
+		if (players[pos->playing-1] == NULL) {
+			players[pos->playing-1] = new Player(algorithm, evalfunc, pos->playing, 0);
+		}
+
+		SearchLimits limits;
+		limits.depth = depth;
+		limits.movetime = limits.gametime = 0;
+		limits.nodes = 0;
+		limits.threads = 1;
+
+		Moves movements;
+		int score = players[pos->playing-1]->Think (pos->game, limits, movements);
+
+		BookEntry *entry = &(*entries)[p];
+		memset (entry, 0, sizeof(*entry));
+		entry->key = pos->game.Hash(pos->playing);
+		entry->score = score;
+		entry->depth = depth;
+		if (movements.size() <= (size_t)BOOKMOVES) {  // Else left out
+			entry->moves = movements.size();
+			memcpy (entry->move, &movements[0], movements.size());
+		}
+	}
+	delete players[0];
+	delete players[1];
+}
+
+// Entries sort by key
+bool EntryBefore ( const BookEntry &a, const BookEntry &b )
+{
+	return(a.key < b.key);
+}
+
+// Entries without moves, turns too long to store, are left out
+bool EntryEmpty ( const BookEntry &e )
+{
+	return(e.moves == 0);
+}
+
+int main ( int argc, char *argv[] )
+{
+	int plies = BOOKPLIES;		// Turns from start
+	int depth = BOOKDEPTH;		// Depth searched
+	string algorithm = ALGORITHMS[1];  // Alpha-beta
+	string evalfunc = EVALFUNCS[0];	// Net score
+	int threads = thread::hardware_concurrency();
+	char *file = NULL;
+	int opt;
+
+	while ((opt = getopt (argc, argv, "p:d:a:f:j:o:")) != -1) {
+		switch (opt) {
+		case 'p':		// Turns from start
+			plies = atoi(optarg);
+			break;
+
+		case 'd':		// Depth searched
+			depth = atoi(optarg);
+			break;
+
+		case 'a':		// Search algorithm
+			algorithm = optarg;
+			break;
+
+		case 'f':		// Evaluation function
+			evalfunc = optarg;
+			break;
+
+		case 'j':		// Searching threads
+			threads = atoi(optarg);
+			break;
+
+		case 'o':		// Book file
+			file = optarg;
+			break;
+
+		default:
+			Usage(argv);
+			return(1);
+		}
+	}
+	if ((algorithm != ALGORITHMS[0]) && (algorithm != ALGORITHMS[1]) && (algorithm != ALGORITHMS[2])) {
+		cerr << "Algorithms are: " << ALGORITHMS[0] << ", " << ALGORITHMS[1] << " or " << ALGORITHMS[2] << "." << endl;
+		Usage(argv);
+		return(1);
+	}
+	if ((evalfunc != EVALFUNCS[0]) && (evalfunc != EVALFUNCS[1])) {
+		cerr << "Evaluation functions are: " << EVALFUNCS[0] << " or " << EVALFUNCS[1] << "." << endl;
+		Usage(argv);
+		return(1);
+	}
+	if ((file == NULL) || (plies < 1) || (depth < 1) || (depth > MAXDEPTH)) {
+		Usage(argv);
+		return(1);
+	}
+	if (threads < 1) threads = 1;
+
+	// Positions up to plies turns from the start, player 1 first
+	vector<BookPosition> positions;
+	unordered_set<HashKey> seen;
+	Game start;
+	BookPosition first = { start, 1 };
+	positions.push_back(first);
+	seen.insert(start.Hash(1));
+	size_t from = 0;
+	int ply;
+	for (ply = 1; ply < plies; ply++) {
+		size_t to = positions.size();
+		vector<BookPosition> next;
+		for (; from < to; from++) {
+			NextTurns (positions[from].game, positions[from].playing, next, seen);
+		}
+		positions.insert(positions.end(), next.begin(), next.end());
+	}
+
+	struct timeval starter;
+	gettimeofday (&starter, NULL);
+	cout << "Searching " << positions.size() << " positions to depth " << depth
+	     << " on " << threads << " threads." << endl;
+
+	vector<BookEntry> entries(positions.size());
+	atomic<long> next(0);
+	vector<thread> workers;
+	int t;
+	for (t = 1; t < threads; t++) {
+		workers.push_back(thread(SearchBook, &positions, &entries, &next, algorithm, evalfunc, depth));
+	}
+	SearchBook (&positions, &entries, &next, algorithm, evalfunc, depth);
+	for (t = 0; t < (int)workers.size(); t++) {
+		workers[t].join();
+	}
+	entries.erase (remove_if (entries.begin(), entries.end(), EntryEmpty), entries.end());
+	sort (entries.begin(), entries.end(), EntryBefore);
+	cout << "Searched in " << TimeSince(&starter) << " secs." << endl;
+
+	BookHeader header;
+	memset (&header, 0, sizeof(header));
+	memcpy (header.magic, BOOKMAGIC, sizeof(header.magic));
+	header.plies = plies;
+	header.depth = depth;
+	header.entries = entries.size();
+
+	ofstream out(file, ios::binary);
+	out.write((char *)&header, sizeof(header));
+	out.write((char *)&entries[0], entries.size() * sizeof(BookEntry));
+	out.close();
+	if (!out) {
+		cerr << "ERROR: Unable to write " << file << "." << endl;
+		return(2);
+	}
+	return(0);
+}
@@ -0,0 +1,221 @@
+
+/*
+ * Compile:
+ *    make mkendgame
+ *
+ * Usage:
+ *    ./mkendgame [-s seeds] [-j threads] -o kalah.egdb
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "game.h"
+#include "endgame.h"
+
+using namespace std;
+
+// Correct usage
+void Usage ( char *argv[] )
+{
+	cerr << "Usage: " << argv[0] << " [-s seeds] [-j threads] -o kalah.egdb" << endl;
+}
+
+// Retrograde analysis
+//
+// A board's value is the net score the player to move still gains from
+// the seeds on it by best play.  Every move either drops seeds off the
+// board (into a score well or by a capture), so the board it leads to
+// is solved at a lower level, or keeps all seeds on the mover's side
+// moving towards the score well.  Sum of seeds times distance from the
+// far hole, over both sides, then strictly grows.  Solving each level
+// in falling order of that sum therefore only looks up solved boards,
+// and boards with the same sum can be solved at once on many threads.
+class Retrograde {
+public:
+	Retrograde ( int s, int t ) : seeds(s), threads(t), values(EndgamePositions(s)) { }
+
+	// Solve all levels
+	void Solve ( );
+
+	// Write database file, 0 if written
+	int Write ( char *file );
+
+private:
+	int seeds;			// Most seeds on board
+	int threads;			// Solving threads
+	vector<signed char> values;	// Board values by index
+
+	// Solve one board
+	void SolveBoard ( long index );
+
+	// Solve boards on one thread, taking the next from shared counter
+	void SolveBoards ( vector<long> *boards, atomic<long> *next );
+};
+
+// Solve one board
+void Retrograde::SolveBoard ( long index )
+{
+	int mine[6], theirs[6];
+	int next1[6], next2[6];
+	int h, m;
+
+	EndgameBoard (index, mine, theirs);
+
+	int left = 0, oppleft = 0;
+	for (h = 0; h < 6; h++) {
+		left += mine[h];
+		oppleft += theirs[h];
+	}
+	if (left == 0) {		// No moves: opponent gathers
+		values[index] = -oppleft;
+		return;
+	}
+
+	int best = -ALLSEEDS;
+	for (m = 0; m < 6; m++) {
+		if (mine[m] == 0) continue;
+
+		Game game;		// Board with mover as player 1
+		for (h = 0; h < 6; h++) {
+			game.EmptySeeds (1, h);
+			game.EmptySeeds (2, h);
+			game.DropSeeds (1, h, mine[h]);
+			game.DropSeeds (2, h, theirs[h]);
+		}
+		game.EmptySeeds (1, 6);
+		game.EmptySeeds (2, 6);
+
+		int endpt = game.KalahMove (1, m);
+		int nextleft = 0;
+		for (h = 0; h < 6; h++) {
+			next1[h] = game.Seeds(1,h);
+			next2[h] = game.Seeds(2,h);
+			nextleft += next1[h];
+		}
+		int value;
+		if ((endpt == 6) && (nextleft > 0)) {	// Bonus move: mover again, unless out of seeds
+			value = game.Score(1) + values[EndgameIndex (next1, next2)];
+		} else {
+			value = game.Score(1) - values[EndgameIndex (next2, next1)];
+		}
+		if (value > best) best = value;
+	}
+	values[index] = best;
+}
+
+// Solve boards on one thread, taking the next from shared counter
+void Retrograde::SolveBoards ( vector<long> *boards, atomic<long> *next )
+{
+	long b;
+	while ((b = (*next)++) < (long)boards->size()) {
+		SolveBoard ((*boards)[b]);
+	}
+}
+
+// Solve all levels
+void Retrograde::Solve ( )
+{
+	struct timeval starter;
+	int level, h;
+
+	gettimeofday (&starter, NULL);
+	for (level = 0; level <= seeds; level++) {
+		long first = EndgamePositions (level-1);
+		long last = EndgamePositions (level);
+
+		// Boards of level grouped by seeds times distance travelled
+		vector< vector<long> > bydist(5*level+1);
+		long index;
+		for (index = first; index < last; index++) {
+			int mine[6], theirs[6];
+			int dist = 0;
+			EndgameBoard (index, mine, theirs);
+			for (h = 0; h < 6; h++) {
+				dist += h * (mine[h] + theirs[h]);
+			}
+			bydist[dist].push_back(index);
+		}
+
+		int d;
+		for (d = 5*level; d >= 0; d--) {
+			atomic<long> next(0);
+			vector<thread> workers;
+			int t;
+			for (t = 1; t < threads; t++) {
+				workers.push_back(thread(&Retrograde::SolveBoards, this, &bydist[d], &next));
+			}
+			SolveBoards (&bydist[d], &next);
+			for (t = 0; t < (int)workers.size(); t++) {
+				workers[t].join();
+			}
+		}
+		cout << "Level " << level << ": " << (last - first) << " boards, "
+		     << TimeSince(&starter) << " secs." << endl;
+	}
+}
+
+// Write database file, 0 if written
+int Retrograde::Write ( char *file )
+{
+	EndgameHeader header;
+	memset (&header, 0, sizeof(header));
+	memcpy (header.magic, ENDGAMEMAGIC, sizeof(header.magic));
+	header.maxseeds = seeds;
+	header.holes = 6;
+	header.positions = values.size();
+
+	ofstream out(file, ios::binary);
+	out.write((char *)&header, sizeof(header));
+	out.write((char *)&values[0], values.size());
+	out.close();
+	if (!out) {
+		cerr << "ERROR: Unable to write " << file << "." << endl;
+		return(1);
+	}
+	return(0);
+}
+
+int main ( int argc, char *argv[] )
+{
+	int seeds = ENDGAMESEEDS;	// Seeds on board
+	int threads = thread::hardware_concurrency();
+	char *file = NULL;
+	int opt;
+
+	while ((opt = getopt (argc, argv, "s:j:o:")) != -1) {
+		switch (opt) {
+		case 's':		// Seeds on board
+			seeds = atoi(optarg);
+			break;
+
+		case 'j':		// Solving threads
+			threads = atoi(optarg);
+			break;
+
+		case 'o':		// Database file
+			file = optarg;
+			break;
+
+		default:
+			Usage(argv);
+			return(1);
+		}
+	}
+	if ((file == NULL) || (seeds < 0) || (seeds > ENDGAMEMAX)) {
+		Usage(argv);
+		cerr << "Seeds must be 0 to " << ENDGAMEMAX << "." << endl;
+		return(1);
+	}
+	if (threads < 1) threads = 1;
+
+	cout << "Solving " << EndgamePositions(seeds) << " boards of up to "
+	     << seeds << " seeds on " << threads << " threads." << endl;
+	Retrograde retro(seeds, threads);
+	retro.Solve();
+	return(retro.Write (file));
+}
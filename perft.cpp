@@ -0,0 +1,182 @@
+
+/*
+ * Compile:
+ *    make
+ *
+ * Usage:
+ *    ./kalah perft [-j threads] [-c] [-r boards] depth [player pits...]
+ */
+
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include "game.h"
+#include "perft.h"
+
+using namespace std;
+
+// Subtree still to count
+template <class G>
+struct PerftSubtree {
+	G game;				// Position at split ply
+	int playing;			// Player to move
+};
+
+// Move sown one seed at a time differs from KalahMove, or taking it
+// back does not restore the game?
+template <class G>
+static int CheckMove ( G &game, int playing, char move )
+{
+	int hole = G::ChooseHole (playing, move);
+	G reference(game), sown(game);
+	MoveUndo refundo, undo;
+
+	int refend = reference.ReferenceMove (playing, hole, refundo);
+	int endpt = sown.KalahMove (playing, hole, undo);
+	if ((endpt != refend) || !sown.Same(reference) || (memcmp (&undo, &refundo, sizeof(undo)) != 0)) {
+		return(1);
+	}
+	sown.UnmakeMove (undo);
+	return(sown.Same(game) ? 0 : 1);
+}
+
+// Count positions below game at ply, to depth.  With split, stop at
+// that ply and save the positions there for other threads instead.
+template <class G>
+static void PerftCount ( G &game, int playing, int ply, int depth, int check,
+			 vector<PerftCounts> &counts, int split, vector<PerftSubtree<G> > *subtrees )
+{
+	if ((subtrees != NULL) && (ply == split)) {
+		PerftSubtree<G> sub = { game, playing };
+		subtrees->push_back(sub);
+		return;
+	}
+
+	char allowed[MAXHOLES];		// Moves allowed
+	int moves = game.MovesAllowed (allowed, playing);
+	int m;
+
+	if (moves == 0) {		// Game over
+		counts[ply].terminals++;
+		return;
+	}
+	if (ply == depth) return;	// Leaf
+
+	PerftCounts &next = counts[ply+1];
+	for (m = 0; m < moves; m++) {
+		if (check) next.differ += CheckMove (game, playing, allowed[m]);
+
+		MoveUndo undo;
+		int endpt = game.KalahMove (playing, G::ChooseHole (playing, allowed[m]), undo);
+		int mover = Opponent(playing);
+		next.nodes++;
+		if (endpt == G::WELL) {
+			next.bonus++;
+			char after[MAXHOLES];	// Out of seeds, the turn passes
+			if (game.MovesAllowed (after, playing) > 0) mover = playing;
+		}
+		if (undo.captured > 0) next.captures++;
+
+		PerftCount (game, mover, ply+1, depth, check, counts, split, subtrees);
+		game.UnmakeMove (undo);
+	}
+}
+
+// Count subtrees on one thread, taking the next from shared counter
+template <class G>
+static void PerftWorker ( vector<PerftSubtree<G> > *subtrees, int split, int depth, int check,
+			  vector<PerftCounts> *counts, atomic<size_t> *next )
+{
+	size_t s;
+	while ((s = (*next)++) < subtrees->size()) {
+		PerftSubtree<G> &sub = (*subtrees)[s];
+		PerftCount<G> (sub.game, sub.playing, split, depth, check, *counts, 0, NULL);
+	}
+}
+
+// Count every game tree position to depth from game with player to
+// move, on threads, into counts per ply
+template <class G>
+void Perft ( G &game, int playing, int depth, int threads, int check, vector<PerftCounts> &counts )
+{
+	PerftCounts zero = { 0, 0, 0, 0, 0 };
+	vector<PerftSubtree<G> > subtrees;
+	int split;
+	int t;
+
+	// Split deep enough that every thread gets plenty of subtrees
+	for (split = 0; ; split++) {
+		counts.assign(depth+1, zero);
+		counts[0].nodes = 1;
+		subtrees.clear();
+		PerftCount (game, playing, 0, depth, check, counts, split, &subtrees);
+		if ((split == depth) || (subtrees.size() >= (size_t)PERFTSPLIT*threads)) break;
+	}
+
+	vector<vector<PerftCounts> > threadcounts(threads, vector<PerftCounts>(depth+1, zero));
+	atomic<size_t> next(0);
+	vector<thread> workers;
+	for (t = 1; t < threads; t++) {
+		workers.push_back(thread(PerftWorker<G>, &subtrees, split, depth, check, &threadcounts[t], &next));
+	}
+	PerftWorker (&subtrees, split, depth, check, &threadcounts[0], &next);
+	for (t = 0; t < (int)workers.size(); t++) {
+		workers[t].join();
+	}
+
+	for (t = 0; t < threads; t++) {	// Merge thread counts
+		int d;
+		for (d = 0; d <= depth; d++) {
+			counts[d].nodes += threadcounts[t][d].nodes;
+			counts[d].bonus += threadcounts[t][d].bonus;
+			counts[d].captures += threadcounts[t][d].captures;
+			counts[d].terminals += threadcounts[t][d].terminals;
+			counts[d].differ += threadcounts[t][d].differ;
+		}
+	}
+}
+
+// Compare every move on random boards with sowing one seed at a time,
+// returning moves that differ
+//
+// Seeds are spread over a few pits at random, so big pits that sow
+// whole laps come up often.
+template <class G>
+long long SowingCheck ( long boards, long long *moves )
+{
+	unsigned int seed = 1;		// Same boards every run
+	long long differ = 0;
+	long b;
+
+	*moves = 0;
+	for (b = 0; b < boards; b++) {
+		int pits[G::PITS];
+		int used = 1 + rand_r(&seed) % G::PITS;  // Pits seeds go in
+		int first = rand_r(&seed) % G::PITS;
+		int s, p;
+
+		memset (pits, 0, sizeof(pits));
+		for (s = 0; s < G::ALLSEEDS; s++) {
+			pits[(first + (rand_r(&seed) % used) * 5) % G::PITS]++;
+		}
+		G game(pits);
+
+		for (p = 1; p <= 2; p++) {
+			char allowed[MAXHOLES];
+			int allow = game.MovesAllowed (allowed, p);
+			int m;
+			for (m = 0; m < allow; m++) {
+				differ += CheckMove (game, p, allowed[m]);
+				(*moves)++;
+			}
+		}
+	}
+	return(differ);
+}
+
+// Counts on every board variant
+#define PERFT_VARIANT(n,s) \
+	template void Perft ( KalahGame<n,s> &game, int playing, int depth, int threads, int check, vector<PerftCounts> &counts ); \
+	template long long SowingCheck<KalahGame<n,s> > ( long boards, long long *moves );
+KALAH_VARIANTS(PERFT_VARIANT)
@@ -0,0 +1,40 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+/*
+ * Compile:
+ *    make
+ *
+ * Usage:
+ *    ./kalah perft [-j threads] [-c] [-r boards] depth [player pits...]
+ */
+
+#include <vector>
+
+using namespace std;
+
+const int PERFTSPLIT = 64;		// Subtrees per thread to share out
+
+// Move generation counts at one ply
+typedef struct {
+	long long nodes;		// Positions reached
+	long long bonus;		// Moves ending in score well
+	long long captures;		// Moves capturing seeds
+	long long terminals;		// Positions where player to move cannot
+	long long differ;		// Moves differing from one seed at a time
+} PerftCounts;
+
+// Count every game tree position to depth from game with player to
+// move, on threads, into counts per ply.  Each sowing is one ply.  A
+// bonus move keeps the same player to move, unless it leaves them no
+// seeds.  With check, every move is also sown one seed at a time and
+// compared, and so is its take back.
+template <class G>
+void Perft ( G &game, int playing, int depth, int threads, int check, vector<PerftCounts> &counts );
+
+// Compare every move on random boards of G with sowing one seed at a
+// time, returning moves that differ
+template <class G>
+long long SowingCheck ( long boards, long long *moves );
+
+#endif
@@ -9,30 +9,63 @@
 
 #include <iostream>
 #include <fstream>
+#include <cstdlib>
 #include <string>
 #include <vector>
+#include <thread>
 #include "game.h"
+#include "table.h"
+#include "endgame.h"
+#include "book.h"
+#include "stats.h"
 #include "player.h"
 
 using namespace std;
 
-Moves Player::record;			// Player move record
-
 // Player initialization
-Player::Player ( char *file, int p )
+template <class G>
+KalahPlayer<G>::KalahPlayer ( char *file, int p, int v, SearchContext *c )
 {
 	algorithm = ALGORITHMS[0];	// Default algorithm: minimax
 	evalfunc = EVALFUNCS[0];	// Default evaluation function
 	player = p;			// Player id
+	verbose = v;			// Show moves?
+	context = (c != NULL ? c : &owncontext);
+	nodes = 0;
+	hashsize = HASHSIZE;		// Default table size
+	quiesce = 0;			// No quiescence search
+	table = NULL;
+	clockused = 0.0;		// No time used yet
+	stopped = 0;
+	haslast = 0;			// No score to centre window on
+	memset (history, 0, sizeof(history));
+	owntable = 1;
+	endgame = NULL;
+	book = NULL;
+	bookmoves = 0;
+	turnscore = turnbook = 0;
+	turndepth = 0;
+	ponderstate = PONDER_NONE;
+	ponderwait = 0;
+	yield = NULL;			// Not suspended
+	yieldarg = NULL;
+	pausedsecs = 0;
+	linelength = 0;
+	helper = 0;			// Main search
+	abandon = NULL;
 
 	ifstream playfile(file);	// Open player description
-	if (!playfile) return;
+	if (!playfile) {
+		table = new TransTable(hashsize);
+		ChooseSearch();
+		return;
+	}
 
 	string cat, val;		// category value
 	playfile >> cat >> val;
 	while (!playfile.eof()) {	// Read player factors
 		if (cat == "algorithm") {
-			if (!((val == ALGORITHMS[0]) || (val == ALGORITHMS[1]))) {
+			if (!((val == ALGORITHMS[0]) || (val == ALGORITHMS[1]) || (val == ALGORITHMS[2]))) {
 				cerr << cat << " " << val << endl;
 			} else {
 				algorithm = val;
@@ -45,36 +78,166 @@ Player::Player ( char *file, int p )
 				evalfunc = val;
 			}
 
+		} else if (cat == "hashsize") {
+			int mb = atoi(val.c_str());
+			if ((mb < 0) || ((mb == 0) && (val != "0"))) {
+				cerr << cat << " " << val << endl;
+			} else {
+				hashsize = mb;
+			}
+
+		} else if (cat == "quiescence") {
+			int plies = atoi(val.c_str());
+			if ((plies < 0) || (plies > QUIESCEPLIES) || ((plies == 0) && (val != "0"))) {
+				cerr << cat << " " << val << endl;
+			} else {
+				quiesce = plies;
+			}
+
 		} else {
 			cerr << "Unknown category: " << cat << " " << val << endl;
 		}
 		playfile >> cat >> val;
 	}
-	cout << "Player " << player << ": algorithm: " << algorithm << " evalfunc: " << evalfunc << endl;
+	table = new TransTable(hashsize);
+	ChooseSearch();
+	if (verbose) {
+		context->Out() << "Player " << player << ": algorithm: " << algorithm << " evalfunc: " << evalfunc << endl;
+	}
 }
 
 // Initialize Player
-Player::Player ( string a, string f, int p )
+template <class G>
+KalahPlayer<G>::KalahPlayer ( string a, string f, int p, int v, int h, int q, SearchContext *c )
 {
 	player = p;
+	verbose = v;
+	context = (c != NULL ? c : &owncontext);
+	nodes = 0;
 	algorithm = a;
 	evalfunc = f;
-	cout << "Player " << player << ": algorithm: " << algorithm << " evalfunc: " << evalfunc << endl;
+	hashsize = h;
+	quiesce = q;
+	table = new TransTable(hashsize);
+	ChooseSearch();
+	clockused = 0.0;		// No time used yet
+	stopped = 0;
+	haslast = 0;			// No score to centre window on
+	memset (history, 0, sizeof(history));
+	owntable = 1;
+	endgame = NULL;
+	book = NULL;
+	bookmoves = 0;
+	turnscore = turnbook = 0;
+	turndepth = 0;
+	ponderstate = PONDER_NONE;
+	ponderwait = 0;
+	yield = NULL;			// Not suspended
+	yieldarg = NULL;
+	pausedsecs = 0;
+	linelength = 0;
+	helper = 0;			// Main search
+	abandon = NULL;
+	if (verbose) {
+		context->Out() << "Player " << player << ": algorithm: " << algorithm << " evalfunc: " << evalfunc << endl;
+	}
+}
+
+// Initialize helper to search alongside main player
+template <class G>
+KalahPlayer<G>::KalahPlayer ( KalahPlayer &main, int h, atomic<int> *a )
+{
+	player = main.player;
+	verbose = 0;
+	context = &owncontext;		// Main search counts helpers' nodes
+	nodes = 0;
+	algorithm = main.algorithm;
+	evalfunc = main.evalfunc;
+	search = main.search;
+	hashsize = main.hashsize;
+	quiesce = main.quiesce;
+	table = main.table;		// Shared table
+	owntable = 0;
+	endgame = main.endgame;
+	book = NULL;			// Main search looks up book
+	bookmoves = 0;
+	turnscore = turnbook = 0;
+	turndepth = 0;
+	ponderstate = PONDER_NONE;
+	ponderwait = 0;
+	yield = NULL;			// Not suspended
+	yieldarg = NULL;
+	pausedsecs = 0;
+	linelength = 0;
+	clockused = 0.0;
+	stopped = 0;
+	lastscore = main.lastscore;
+	haslast = main.haslast;
+	memcpy (history, main.history, sizeof(history));
+	helper = h;
+	abandon = a;
+	helpnodes = 0;
+}
+
+template <class G>
+KalahPlayer<G>::~KalahPlayer ( )
+{
+	StopPonder (0);
+	if (owntable) delete table;
+}
+
+// Search in a table shared with other players of the same side
+template <class G>
+void KalahPlayer<G>::ShareTable ( TransTable *t )
+{
+	if (owntable) delete table;
+	table = t;
+	owntable = 0;
 }
 
 // Take a player's turn
-int Player::TakeTurn ( Game &game, int depth )
+template <class G>
+int KalahPlayer<G>::TakeTurn ( G &game, SearchLimits &limits )
 {
 	Moves movements;
 	size_t m;
 
-	MOVE_GEN (game, depth, movements);
+	turnscore = 0;
+	turnbook = 0;
+	int pondered = ponderer.joinable();
+	int hit = pondered && game.Same(ponderpos);
+	if ((book != NULL) && book->Lookup (game, player, movements)) {
+		StopPonder (0);
+		bookmoves++;		// Opening move known
+		turnbook = 1;
+	} else {
+		if (StopPonder (hit)) {	// Searched while opponent moved
+			movements = pondermoves;
+			turnscore = ponderscore;
+		} else {
+			turnscore = MOVE_GEN (game, limits, movements);
+		}
+		if (verbose && (linelength > 1)) {
+			context->Out() << "Player " << player << ": expects";
+			for (m = 0; m < (size_t)linelength; m++) {
+				context->Out() << " " << line[m];
+			}
+			context->Out() << endl;
+		}
+	}
+	if (pondered) {			// Counted once the ponder thread is done
+		STAT(stats.ponders++);
+		STAT(stats.ponderhits += hit);
+	}
 	size_t moves = movements.size();
 	for (m = 0; m < moves; m++) {
-		RecordMove(movements[m]);
-		cout << "Player " << player << ": moves " << movements[m] << endl;
-		game.KalahMove (player, ChooseHole (player, movements[m]));
+		context->RecordMove(movements[m]);
+		if (verbose) {
+			context->Out() << "Player " << player << ": moves " << movements[m] << endl;
+		}
+		game.KalahMove (player, G::ChooseHole (player, movements[m]));
 	}
+	context->AddNodes (moves);	// Moves played are game nodes too
 
 	if (moves > 0) return(0);	// If moved, then game not won
 
@@ -87,242 +250,797 @@ int Player::TakeTurn ( Game &game, int depth )
 }
 
 // Plan player's move
-void Player::MOVE_GEN ( Game game, int depth, Moves &movements )
+//
+// Without time or node limits the search goes straight to the depth
+// asked for.  Otherwise, or when a scheduler may stop it, it deepens one
+// ply at a time and keeps the move of the last depth it finished.
+template <class G>
+int KalahPlayer<G>::MOVE_GEN ( G &game, SearchLimits &limits, Moves &movements )
 {
-	if (algorithm == ALGORITHMS[0]) {	// Minimax 
-		MINMAX_AB (game, depth, player, movements);
-	} else if (algorithm == ALGORITHMS[1]) {  // Alpha-beta
-		int inf = game.InfiniteScore();
-		ALPHA_BETA_SEARCH (game, depth, -inf, inf, player, movements);
+	int timed = (limits.movetime > 0) || (limits.gametime > 0) || (limits.nodes > 0) || (yield != NULL);
+	int depth = (limits.depth > 0 ? limits.depth : MAXDEPTH);
+	int score = 0;
+	int d;
+
+	table->NewSearch();		// Earlier turns' positions age
+	memset (killers, 0, sizeof(killers));
+	for (d = 0; d < MAXHOLES; d++) {  // Earlier turns' history fades
+		history[0][d] /= 2;
+		history[1][d] /= 2;
+	}
+	gettimeofday (&searchstart, NULL);
+	pausedsecs = 0;
+	startnodes = nodes;
+	checknodes = CHECKNODES;
+	stopped = 0;
+
+	budget = limits.movetime;	// Share out what is left of the clock
+	if (limits.gametime > 0) {
+		double share = (limits.gametime - clockused) / MOVESTOGO;
+		if (share < MINMOVETIME) share = MINMOVETIME;	// 0 would be no limit
+		if ((budget <= 0) || (share < budget)) budget = share;
+	}
+	nodelimit = limits.nodes;
+	if (ponderwait) {		// Limits wait until the opponent moves
+		ponderbudget = budget;
+		pondernodelimit = nodelimit;
+		budget = 0;
+		nodelimit = 0;
+		timed = 1;
+	}
+
+	// Helpers search the same position on other threads (Lazy SMP)
+	atomic<int> helpersdone(0);
+	vector<KalahPlayer *> helpers;
+	vector<thread> workers;
+	for (d = 1; d < limits.threads; d++) {
+		KalahPlayer *help = new KalahPlayer(*this, d, &helpersdone);
+		helpers.push_back(help);
+		workers.push_back(thread(&KalahPlayer::HelpSearch, help, game, depth));
+	}
+
+	linelength = 0;
+	turndepth = 0;
+	if (!timed) {			// Fixed depth
+		score = SearchDepth (game, depth, movements);
+		SaveLine();
+		turndepth = depth;
+
+	} else {			// Iterative deepening
+		for (d = 1; d <= depth; d++) {
+			Moves trymoves;
+			int trying = SearchDepth (game, d, trymoves);
+			if (stopped) break;	// Depth not finished
+			score = trying;
+			movements = trymoves;
+			SaveLine();
+			turndepth = d;
+
+			// Next depth would not finish in time
+			if ((budget > 0) && (SearchTime() > budget/2)) break;
+		}
 	}
+
+	helpersdone = 1;		// Stop and count helpers
+	for (d = 0; d < (int)workers.size(); d++) {
+		workers[d].join();
+		nodes += helpers[d]->helpnodes;
+		stats.Merge (helpers[d]->stats);
+		delete helpers[d];
+	}
+	if (ponderstate.load() == PONDER_NONE) {	// Pondering counts when it stops
+		context->AddNodes (nodes - startnodes);
+		clockused += SearchTime();
+	}
+	return(score);
 }
 
-// Plan player's move using Minimax strategy
-int Player::MINMAX_AB ( Game &game, int depth, int playing, Moves &movements )
+// Helper thread searches alongside main search
+//
+// Odd helpers search a ply deeper than the main search, and minimax
+// helpers start their root moves at different holes, so they fill the
+// shared table ahead of the main search.  They stop once it is done.
+template <class G>
+void KalahPlayer<G>::HelpSearch ( G game, int depth )
 {
-	char allowed[6];		// Moves allowed
-	size_t moves = game.MovesAllowed (allowed, playing);
-	size_t b, m;
+	int d;
+
+	memset (killers, 0, sizeof(killers));
+	startnodes = nodes;
+	checknodes = CHECKNODES;
+	budget = 0;			// Main search stops helpers
+	nodelimit = 0;
+	stopped = 0;
 
-	if (DEEP_ENOUGH(depth, moves)) {	// Search depth done
-		return(EvaluateGame (game, playing));
+	int last = depth + (helper % 2);
+	if (last > MAXDEPTH) last = MAXDEPTH;
+	for (d = 1 + (helper % 2); (d <= last) && !stopped; d++) {
+		Moves trymoves;
+		SearchDepth (game, d, trymoves);
 	}
+	helpnodes = nodes - startnodes;
+}
 
-	if (playing == player) {	// Maximizing player
-		int minimax = -game.InfiniteScore();
-		for (m = 0; m < moves; m++) {
-			Game moved(game);	// Game with move
-			Moves trymoves;
-			trymoves.push_back(allowed[m]);
-			int choice = ChooseHole (playing, allowed[m]);  // Try move
-
-			int endpt = moved.KalahMove (playing, choice);
-			if (endpt == 6) {	// Bonus moves
-				BonusMove (moved, playing, trymoves);
-				for (b = 1; b < trymoves.size(); b++) {
-					int bonchoice = ChooseHole (playing, trymoves[b]);
-					moved.KalahMove (playing, bonchoice);
-				}
-			}
+// Search the position the best line expects after the opponent's turn,
+// until the opponent has moved
+//
+// The opponent's turn is taken from the line the last search expected,
+// after this player's own moves.  The ponder search deepens without
+// limits in its own thread and on this player's table, which the
+// opponent does not touch.
+template <class G>
+void KalahPlayer<G>::StartPonder ( G game, SearchLimits &limits )
+{
+	char allowed[MAXHOLES];		// Moves allowed
+	int opp = Opponent(player);
+	int endpt = G::WELL;
+	int t = 0;
+	int expected = 0;		// Opponent's moves expected
 
-			Moves oppmove;		// Opponent's move
-			int moveval = MINMAX_AB (moved, depth-1, Opponent(playing), oppmove);
-			if (moveval > minimax) {  // Best move
-				minimax = moveval;
-				movements = trymoves;
-			}
+	if (turnbook || ponderer.joinable()) return;
+	while ((t < linelength) && (islower(line[t]) ? player == 1 : player == 2)) {
+		t++;			// Own turn, already played
+	}
+	while ((t < linelength) && (endpt == G::WELL) && (islower(line[t]) ? opp == 1 : opp == 2)) {
+		int hole = G::ChooseHole (opp, line[t++]);
+		if ((hole < 0) || (hole >= G::WELL) || (game.Seeds(opp, hole) == 0)) return;
+		endpt = game.KalahMove (opp, hole);
+		expected++;
+	}
+	if ((expected == 0) || ((endpt == G::WELL) && (game.MovesAllowed (allowed, opp) > 0))) {
+		return;			// Opponent's turn not known to its end
+	}
+	if (game.MovesAllowed (allowed, player) == 0) return;	// Game over
+
+	if (verbose) {
+		context->Out() << "Player " << player << ": ponders after";
+		for (t -= expected; expected > 0; expected--) {
+			context->Out() << " " << line[t++];
 		}
-		return(minimax);
+		context->Out() << endl;
+	}
+	ponderpos = game;
+	ponderfrom = nodes;
+	ponderwait = 1;
+	ponderstate = PONDER_ON;
+	ponderer = thread(&KalahPlayer::PonderSearch, this, game, limits);
+}
 
-	} else {			// Minimizing (other) player
-		int minimax = +game.InfiniteScore();
-		for (m = 0; m < moves; m++) {
-			Game moved(game);	// Game with move
-			Moves trymoves;
-			trymoves.push_back(allowed[m]);
-			int choice = ChooseHole (playing, allowed[m]);  // Try move
-
-			int endpt = moved.KalahMove (playing, choice);
-			if (endpt == 6) {	// Bonus moves
-				BonusMove (moved, playing, trymoves);
-				for (b = 1; b < trymoves.size(); b++) {
-					int bonchoice = ChooseHole (playing, trymoves[b]);
-					moved.KalahMove (playing, bonchoice);
-				}
+// Ponder thread searches position expected after opponent's turn
+template <class G>
+void KalahPlayer<G>::PonderSearch ( G game, SearchLimits limits )
+{
+	ponderscore = MOVE_GEN (game, limits, pondermoves);
+}
+
+// Stop pondering, unless hit: the opponent played the turn expected, so
+// the ponder search goes on as this turn's search.  Its time and nodes
+// count from when pondering started, so a search that has already used
+// them plays at once, but only the time after the hit comes off the
+// game clock.  Nonzero if hit.
+template <class G>
+int KalahPlayer<G>::StopPonder ( int hit )
+{
+	if (!ponderer.joinable()) return(0);
+
+	gettimeofday (&hitstart, NULL);
+	ponderstate.store (hit ? PONDER_HIT : PONDER_MISS, memory_order_release);
+	ponderer.join();
+	ponderstate = PONDER_NONE;
+	ponderwait = 0;
+	context->AddNodes (nodes - ponderfrom);	// Pondering searched too
+	if (hit) {
+		clockused += TimeSince(&hitstart);
+	}
+	if (verbose) {
+		context->Out() << "Player " << player << ": ponder " << (hit ? "hit" : "miss") << endl;
+	}
+	return(hit);
+}
+
+// Choose search for algorithm and evalfunc
+//
+// The names are compared once here, so the search and evaluation are
+// compiled together for each pair with no checks at the leaves.
+template <class G>
+void KalahPlayer<G>::ChooseSearch ( )
+{
+	if (algorithm == ALGORITHMS[2]) {	// Principal variation search
+		if (evalfunc == EVALFUNCS[1]) {
+			search = &KalahPlayer::SearchWith<PVSSearch, MyScoreEval>;
+		} else {
+			search = &KalahPlayer::SearchWith<PVSSearch, NetScoreEval>;
+		}
+	} else if (algorithm == ALGORITHMS[1]) {	// Alpha-beta
+		if (evalfunc == EVALFUNCS[1]) {
+			search = &KalahPlayer::SearchWith<AlphaBetaSearch, MyScoreEval>;
+		} else {
+			search = &KalahPlayer::SearchWith<AlphaBetaSearch, NetScoreEval>;
+		}
+	} else {			// Minimax
+		if (evalfunc == EVALFUNCS[1]) {
+			search = &KalahPlayer::SearchWith<MinimaxSearch, MyScoreEval>;
+		} else {
+			search = &KalahPlayer::SearchWith<MinimaxSearch, NetScoreEval>;
+		}
+	}
+}
+
+// Search one depth for player's move
+//
+// The score of each depth finished centres the next search's window.
+template <class G>
+int KalahPlayer<G>::SearchDepth ( G &game, int depth, Moves &movements )
+{
+	rootdepth = depth;
+#ifdef NOSTATS
+	int score = (this->*search) (game, depth, movements);
+#else
+	struct timeval starter;
+	long searched = nodes;
+	gettimeofday (&starter, NULL);
+	int score = (this->*search) (game, depth, movements);
+	if (!stopped) {			// Depth finished
+		stats.iterations[depth]++;
+		stats.iternodes[depth] += nodes - searched;
+		stats.itersecs[depth] += TimeSince(&starter);
+	}
+#endif
+	if (!stopped) {
+		lastscore = score;
+		haslast = 1;
+	}
+	return(score);
+}
+
+// Search one depth with algorithm and evaluation
+template <class G>
+template <class Search, class Eval>
+int KalahPlayer<G>::SearchWith ( G &game, int depth, Moves &movements )
+{
+	int score;
+	bonusat[0] = 0;
+	if (Search::alphabeta) {
+		int inf = game.InfiniteScore();
+		int alpha = -inf;
+		int beta = inf;
+		if (Search::pvs && haslast) {	// Aspiration window
+			alpha = lastscore - ASPIRATION;
+			beta = lastscore + ASPIRATION;
+		}
+		score = ALPHA_BETA_SEARCH<Search, Eval> (game, depth, 0, alpha, beta, player);
+
+		// Missed the window, so open the side it failed on and search again
+		while (!stopped && (((score <= alpha) && (alpha > -inf)) || ((score >= beta) && (beta < inf)))) {
+			STAT(stats.aspirations++);
+			if (score <= alpha) {
+				alpha = -inf;
+			} else {
+				beta = inf;
 			}
+			score = ALPHA_BETA_SEARCH<Search, Eval> (game, depth, 0, alpha, beta, player);
+		}
+	} else {
+		score = MINMAX_AB<Eval> (game, depth, 0, player);
+	}
+	RootTurn (game, movements);
+	return(score);
+}
 
-			Moves oppmove;		// Opponent's move
-			int moveval = MINMAX_AB (moved, depth-1, Opponent(playing), oppmove);
-			if (moveval < minimax) {  // Best defence
-				minimax = moveval;
-				movements = trymoves;
+// Player's turn from the best line: its first move and the bonus moves
+// after it
+//
+// A bonus chain that met a position searched before ends the line
+// early, so the rest of the turn comes from the table's moves.
+template <class G>
+void KalahPlayer<G>::RootTurn ( G game, Moves &movements )
+{
+	char allowed[MAXHOLES];		// Moves allowed
+	int moves = game.MovesAllowed (allowed, player);
+	int t = 0;
+
+	movements.clear();
+	while (moves > 0) {
+		char move = allowed[0];	// Any move, if nothing better known
+		TableEntry entry;
+		if (t < pvlength[0]) {
+			move = pv[0][t++];
+		} else if (table->Probe (game.Hash(player), entry) &&
+			   (memchr (allowed, entry.move, moves) != NULL)) {
+			move = entry.move;
+		}
+		movements.push_back(move);
+		if (game.KalahMove (player, G::ChooseHole (player, move)) != G::WELL) break;
+		moves = game.MovesAllowed (allowed, player);
+	}
+}
+
+// Keep line of depth just finished
+template <class G>
+void KalahPlayer<G>::SaveLine ( )
+{
+	linelength = pvlength[0];
+	memcpy (line, pv[0], linelength);
+}
+
+// Search must stop now?
+//
+// The main search always finishes its first depth so there is a move to
+// play, even when its scheduler cancels it.  Only a missed ponder, whose
+// move is thrown away, stops sooner.
+template <class G>
+int KalahPlayer<G>::OutOfTime ( )
+{
+	if (stopped) return(1);
+	if (--checknodes > 0) return(0);
+	checknodes = CHECKNODES;
+
+	if (ponderwait) {		// Pondering: no limits until opponent moves
+		int state = ponderstate.load(memory_order_acquire);
+		if (state == PONDER_MISS) {
+			stopped = 1;	// Opponent moved otherwise
+			return(1);
+		}
+		if (state != PONDER_HIT) return(0);
+		ponderwait = 0;		// Limits count from when pondering started
+		budget = ponderbudget;
+		nodelimit = pondernodelimit;
+	}
+
+	int cancel = 0;
+	if (yield != NULL) {		// Scheduler may suspend or stop search
+		struct timeval paused;
+		gettimeofday (&paused, NULL);
+		cancel = (*yield)(yieldarg);
+		pausedsecs += TimeSince(&paused);
+	}
+
+	if ((abandon != NULL) && abandon->load(memory_order_relaxed)) {
+		stopped = 1;		// Main search done
+	} else if (rootdepth <= 1) {
+		return(0);
+	} else if (cancel) {
+		stopped = 1;		// Scheduler stopped it
+	} else if ((nodelimit > 0) && (nodes - startnodes >= nodelimit)) {
+		stopped = 1;		// Out of nodes
+	} else if ((budget > 0) && (SearchTime() >= budget)) {
+		stopped = 1;		// Out of time
+	}
+	return(stopped);
+}
+
+// Try table's best move first
+static void HashMoveFirst ( char allowed[], size_t moves, char hashmove )
+{
+	size_t m;
+	for (m = 0; m < moves; m++) {
+		if (allowed[m] == hashmove) {
+			for (; m > 0; m--) {	// Shift earlier moves down
+				allowed[m] = allowed[m-1];
 			}
+			allowed[0] = hashmove;
+			return;
+		}
+	}
+}
+
+// Start moves at a different hole
+static void RotateMoves ( char allowed[], size_t moves, int skew )
+{
+	char rotated[MAXHOLES];
+	size_t m;
+
+	if (moves == 0) return;
+	for (m = 0; m < moves; m++) {
+		rotated[m] = allowed[(m + skew) % moves];
+	}
+	memcpy (allowed, rotated, moves);
+}
+
+// Order moves to search the likeliest cutoff first
+//
+// Table's best move, then moves ending in the score well (bonus move),
+// then captures by seeds captured, then this ply's killer moves, then
+// moves by history of cutoffs.
+template <class G>
+void KalahPlayer<G>::OrderMoves ( G &game, int playing, char allowed[], size_t moves, int ply, char hashmove )
+{
+	int order[MAXHOLES];			// Order score of each move
+	size_t m, o;
+
+	for (m = 0; m < moves; m++) {
+		int hole = G::ChooseHole (playing, allowed[m]);
+		int captures;
+		if (allowed[m] == hashmove) {
+			order[m] = ORDERHASH;
+		} else if (game.MoveEnd (playing, hole) == G::WELL) {
+			order[m] = ORDERBONUS;
+		} else if ((captures = game.MoveCaptures (playing, hole)) > 0) {
+			order[m] = ORDERCAPTURE + captures;
+		} else if (allowed[m] == killers[ply][0]) {
+			order[m] = ORDERKILLER + 1;
+		} else if (allowed[m] == killers[ply][1]) {
+			order[m] = ORDERKILLER;
+		} else {
+			order[m] = history[playing-1][hole];
+		}
+	}
+
+	for (m = 1; m < moves; m++) {	// Insertion sort, keeps hole order on ties
+		char move = allowed[m];
+		int score = order[m];
+		for (o = m; (o > 0) && (order[o-1] < score); o--) {
+			allowed[o] = allowed[o-1];
+			order[o] = order[o-1];
+		}
+		allowed[o] = move;
+		order[o] = score;
+	}
+}
+
+// Remember move that cut off search
+template <class G>
+void KalahPlayer<G>::CutoffMove ( int playing, char move, size_t tried, int ply, int depth )
+{
+	STAT(stats.cutoffs++);
+	STAT(stats.cutoffat[tried]++);
+
+	if (killers[ply][0] != move) {	// Newest killer first
+		killers[ply][1] = killers[ply][0];
+		killers[ply][0] = move;
+	}
+
+	int *hist = &history[playing-1][G::ChooseHole (playing, move)];
+	*hist += depth * depth;
+	if (*hist >= ORDERKILLER) {	// Keep history below killers
+		int h;
+		for (h = 0; h < MAXHOLES; h++) {
+			history[0][h] /= 2;
+			history[1][h] /= 2;
 		}
-		return(minimax);
 	}
 }
 
-// Select bonus move for player
-void Player::BonusMove ( Game &game, int playing, Moves &trymoves )
+// Player to move after playing's move ended at endpt
+//
+// A move ending in the score well earns a bonus move: the same player
+// moves again, in the same turn, at the same depth.  With no seeds left
+// to move, the turn passes, as it does in the game.
+template <class G>
+int KalahPlayer<G>::NextMover ( G &game, int playing, int endpt, int ply )
+{
+	char allowed[MAXHOLES];
+
+	if ((endpt == G::WELL) && (game.MovesAllowed (allowed, playing) > 0)) {
+		bonusat[ply+1] = bonusat[ply] + 1;
+		return(playing);
+	}
+	STAT(stats.chains[bonusat[ply]]++);
+	bonusat[ply+1] = 0;
+	return(Opponent(playing));
+}
+
+// Plan player's move using Minimax strategy
+//
+// Bonus moves are plies of their own, searched for the same player
+// without using up depth, so the table finds chains that reach the
+// same position in another order.
+template <class G>
+template <class Eval>
+int KalahPlayer<G>::MINMAX_AB ( G &game, int depth, int ply, int playing )
 {
-	char allowed[6];		// Moves allowed
+	char allowed[MAXHOLES];		// Moves allowed
 	size_t moves = game.MovesAllowed (allowed, playing);
-	Moves bonus;
-	size_t b, m;
+	size_t m;
+	int solved;
 
-	if (moves == 0) return;		// No bonus moves
+	pvlength[ply] = ply;		// No line below yet
+	STAT(stats.nodes[rootdepth-depth]++);
+	if ((depth < rootdepth) && SolvedGame<Eval> (game, playing, &solved)) {
+		STAT(stats.endgames++);
+		return(solved);		// Endgame known
+	}
+	if (DEEP_ENOUGH(depth, ply, moves)) {	// Search depth done
+		STAT(stats.leaves++);
+		return(EvaluateGame<Eval> (game, player));
+	}
+	if (OutOfTime()) return(0);	// Result thrown away
 
-	if (playing == player ) {
-		int bonval = -game.InfiniteScore();
+	HashKey key = game.Hash(playing);
+	TableEntry entry;
+	int tabled = (depth >= TABLEDEPTH) || (bonusat[ply] > 0);  // Chains meet at any depth
+	if (tabled && Probe (key, entry)) {  // Searched before
+		if ((ply > 0) && (entry.depth >= depth)) {
+			TableLine (ply, entry.move);
+			return(entry.score);
+		}
+		HashMoveFirst (allowed, moves, entry.move);
+	}
+	if ((depth == rootdepth) && (helper > 0)) {
+		RotateMoves (allowed, moves, helper);  // Helper starts elsewhere
+	}
 
+	int minimax;
+	if (playing == player) {	// Maximizing player
+		minimax = -game.InfiniteScore();
 		for (m = 0; m < moves; m++) {
-			Game bongame(game);
-			Moves bonmoves;
-			bonmoves.push_back(allowed[m]);
-			int choice = ChooseHole (playing, allowed[m]);  // Try move
-
-			int endpt = bongame.KalahMove (playing, choice);
-			if (endpt == 6) {	// Bonus move
-				BonusMove (bongame, playing, bonmoves);
-				for (b = 1; b < bonmoves.size(); b++) {
-					int bonchoice = ChooseHole (playing, bonmoves[b]);
-					bongame.KalahMove (playing, bonchoice);
-				}
-			}
+			MoveUndo undo;
+			int endpt = game.KalahMove (playing, G::ChooseHole (playing, allowed[m]), undo);
+			int next = NextMover (game, playing, endpt, ply);
+			nodes++;
 
-			int evalgame = EvaluateGame (bongame, playing);
-			if (evalgame > bonval) {  // Best move
-				bonval = evalgame;
-				bonus = bonmoves;
+			int moveval = MINMAX_AB<Eval> (game, (next == playing ? depth : depth-1), ply+1, next);
+			game.UnmakeMove (undo);
+			if (stopped) return(0);
+			if (moveval > minimax) {  // Best move
+				minimax = moveval;
+				UpdatePV (ply, allowed[m]);
 			}
 		}
 
-	} else {
-		int bonval = +game.InfiniteScore();
-
+	} else {			// Minimizing (other) player
+		minimax = +game.InfiniteScore();
 		for (m = 0; m < moves; m++) {
-			Game bongame(game);
-			Moves bonmoves;
-			bonmoves.push_back(allowed[m]);
-			int choice = ChooseHole (playing, allowed[m]);  // Try move
-
-			int endpt = bongame.KalahMove (playing, choice);
-			if (endpt == 6) {	// Bonus move
-				BonusMove (bongame, playing, bonmoves);
-				for (b = 1; b < bonmoves.size(); b++) {
-					int bonchoice = ChooseHole (playing, bonmoves[b]);
-					bongame.KalahMove (playing, bonchoice);
-				}
-			}
+			MoveUndo undo;
+			int endpt = game.KalahMove (playing, G::ChooseHole (playing, allowed[m]), undo);
+			int next = NextMover (game, playing, endpt, ply);
+			nodes++;
 
-			int evalgame = EvaluateGame (bongame, playing);
-			if (evalgame < bonval) {  // Best move
-				bonval = evalgame;
-				bonus = bonmoves;
+			int moveval = MINMAX_AB<Eval> (game, (next == playing ? depth : depth-1), ply+1, next);
+			game.UnmakeMove (undo);
+			if (stopped) return(0);
+			if (moveval < minimax) {  // Best defence
+				minimax = moveval;
+				UpdatePV (ply, allowed[m]);
 			}
 		}
 	}
 
-	for (b = 0; b < bonus.size(); b++) {
-		trymoves.push_back(bonus[b]);
+	if (tabled) {
+		table->Store (key, depth, BOUND_EXACT, minimax, pv[ply][ply]);
 	}
+	return(minimax);
 }
 
 // Plan player's move using Alpha-Beta strategy
-int Player::ALPHA_BETA_SEARCH ( Game &game, int depth, int alpha, int beta, int playing, Moves &movements )
+//
+// Principal variation search expects the first (best ordered) move to be
+// best, so proves each later move worse with a null window, searching
+// again with the full window only when it is not.  Bonus moves are
+// searched as plies of the same player, as in MINMAX_AB, so alpha-beta
+// cuts off inside chains too.
+template <class G>
+template <class Search, class Eval>
+int KalahPlayer<G>::ALPHA_BETA_SEARCH ( G &game, int depth, int ply, int alpha, int beta, int playing )
 {
-	char allowed[6];		// Moves allowed
+	char allowed[MAXHOLES];		// Moves allowed
 	size_t moves = game.MovesAllowed (allowed, playing);
-	size_t b, m;
+	size_t m;
+	int solved;
+
+	pvlength[ply] = ply;		// No line below yet
+	STAT(stats.nodes[rootdepth-depth]++);
+	if ((depth < rootdepth) && SolvedGame<Eval> (game, playing, &solved)) {
+		STAT(stats.endgames++);
+		return(solved);		// Endgame known
+	}
+	if (DEEP_ENOUGH (depth, ply, moves)) {	// Search depth done
+		if ((quiesce > 0) && (moves > 0)) {
+			return(QUIESCE<Eval> (game, quiesce, alpha, beta, playing));
+		}
+		STAT(stats.leaves++);
+		return(EvaluateGame<Eval> (game, player));
+	}
+	if (OutOfTime()) return(0);	// Result thrown away
 
-	if (DEEP_ENOUGH (depth, moves)) {	// Search depth done
-		return(EvaluateGame (game, playing));
+	HashKey key = game.Hash(playing);
+	TableEntry entry;
+	char hashmove = 0;		// Table's best move
+	int tabled = (depth >= TABLEDEPTH) || (bonusat[ply] > 0);  // Chains meet at any depth
+	if (tabled && Probe (key, entry)) {  // Searched before
+		if ((ply > 0) && (entry.depth >= depth)) {
+			int score = entry.score;
+			if ((entry.bound == BOUND_EXACT) ||
+			    ((entry.bound == BOUND_LOWER) && (score >= beta)) ||
+			    ((entry.bound == BOUND_UPPER) && (score <= alpha))) {
+				TableLine (ply, entry.move);
+				return(score);
+			}
+		}
+		hashmove = entry.move;
 	}
+	OrderMoves (game, playing, allowed, moves, ply, hashmove);
 
+	int alphastart = alpha;	// Window searched
+	int betastart = beta;
+	int alphabeta;
 	if (playing == player) {	// Maximizing player
-		int alphabeta = -game.InfiniteScore();
+		alphabeta = -game.InfiniteScore();
 		for (m = 0; m < moves; m++) {
-			Game moved(game);	// Game with move
-			Moves trymoves;
-			trymoves.push_back(allowed[m]);
-			int choice = ChooseHole (playing, allowed[m]);  // Try move
-
-			int endpt = moved.KalahMove (playing, choice);
-			if (endpt == 6) {	// Bonus moves
-				BonusMove (moved, playing, trymoves);
-				for (b = 1; b < trymoves.size(); b++) {
-					int bonchoice = ChooseHole (playing, trymoves[b]);
-					moved.KalahMove (playing, bonchoice);
+			MoveUndo undo;
+			int endpt = game.KalahMove (playing, G::ChooseHole (playing, allowed[m]), undo);
+			int next = NextMover (game, playing, endpt, ply);
+			nodes++;
+			int nextdepth = (next == playing ? depth : depth-1);
+
+			int moveval;
+			if (Search::pvs && (m > 0)) {	// Null window
+				moveval = ALPHA_BETA_SEARCH<Search, Eval> (game, nextdepth, ply+1, alpha, alpha+1, next);
+				if ((moveval > alpha) && (moveval < beta) && !stopped) {
+					STAT(stats.researches++);
+					moveval = ALPHA_BETA_SEARCH<Search, Eval> (game, nextdepth, ply+1, alpha, beta, next);
 				}
+			} else {
+				moveval = ALPHA_BETA_SEARCH<Search, Eval> (game, nextdepth, ply+1, alpha, beta, next);
 			}
-
-			Moves oppmove;		// Opponent's move
-			int moveval = ALPHA_BETA_SEARCH (moved, depth-1, alpha, beta, Opponent(playing), oppmove);
+			game.UnmakeMove (undo);
+			if (stopped) return(0);
 			if (moveval > alphabeta) {  // Best move
 				alphabeta = moveval;
-				movements = trymoves;
+				UpdatePV (ply, allowed[m]);
 			}
 			if (moveval > alpha) {	// Max(alpha, moveval)
 				alpha = moveval;
 			}
-			if (moveval >= beta) break;  // Cutoff
+			if (moveval >= beta) {	// Cutoff
+				CutoffMove (playing, allowed[m], m, ply, depth);
+				break;
+			}
 		}
-		return(alphabeta);
 
 	} else {			// Minimizing (other) player
-		int alphabeta = +game.InfiniteScore();
+		alphabeta = +game.InfiniteScore();
 		for (m = 0; m < moves; m++) {
-			Game moved(game);	// Game with move
-			Moves trymoves;
-			trymoves.push_back(allowed[m]);
-			int choice = ChooseHole (playing, allowed[m]);  // Try move
-
-			int endpt = moved.KalahMove (playing, choice);
-			if (endpt == 6) {	// Bonus moves
-				BonusMove (moved, playing, trymoves);
-				for (b = 1; b < trymoves.size(); b++) {
-					int bonchoice = ChooseHole (playing, trymoves[b]);
-					moved.KalahMove (playing, bonchoice);
+			MoveUndo undo;
+			int endpt = game.KalahMove (playing, G::ChooseHole (playing, allowed[m]), undo);
+			int next = NextMover (game, playing, endpt, ply);
+			nodes++;
+			int nextdepth = (next == playing ? depth : depth-1);
+
+			int moveval;
+			if (Search::pvs && (m > 0)) {	// Null window
+				moveval = ALPHA_BETA_SEARCH<Search, Eval> (game, nextdepth, ply+1, beta-1, beta, next);
+				if ((moveval > alpha) && (moveval < beta) && !stopped) {
+					STAT(stats.researches++);
+					moveval = ALPHA_BETA_SEARCH<Search, Eval> (game, nextdepth, ply+1, alpha, beta, next);
 				}
+			} else {
+				moveval = ALPHA_BETA_SEARCH<Search, Eval> (game, nextdepth, ply+1, alpha, beta, next);
 			}
-
-			Moves oppmove;		// Opponent's move
-			int moveval = ALPHA_BETA_SEARCH (moved, depth-1, alpha, beta, Opponent(playing), oppmove);
+			game.UnmakeMove (undo);
+			if (stopped) return(0);
 			if (moveval < alphabeta) {  // Best defence
 				alphabeta = moveval;
-				movements = trymoves;
+				UpdatePV (ply, allowed[m]);
 			}
 			if (moveval < beta) {	// Min(beta, moveval)
 				beta = moveval;
 			}
-			if (moveval <= alpha) break;  // Cutoff
+			if (moveval <= alpha) {	// Cutoff
+				CutoffMove (playing, allowed[m], m, ply, depth);
+				break;
+			}
 		}
-		return(alphabeta);
 	}
+
+	int bound = BOUND_EXACT;	// Score within window
+	if (alphabeta <= alphastart) {
+		bound = BOUND_UPPER;	// Failed low
+	} else if (alphabeta >= betastart) {
+		bound = BOUND_LOWER;	// Failed high
+	}
+	if (tabled) {
+		table->Store (key, depth, bound, alphabeta, pv[ply][ply]);
+	}
+	return(alphabeta);
+}
+
+// Search captures and bonus moves past the depth until quiet
+//
+// The player to move may stand on the position's score instead of
+// moving (stand pat), so only moves that take seeds at once are
+// searched: bonus moves, then captures by seeds captured.  A capture
+// scores exactly the seeds captured, the capturing seed and any seeds
+// sown into the well on the way, so one that cannot reach the window
+// even with DELTAMARGIN more is not tried (delta pruning).  Bonus moves
+// go on into chains of unknown gain, so are always tried.
+template <class G>
+template <class Eval>
+int KalahPlayer<G>::QUIESCE ( G &game, int qdepth, int alpha, int beta, int playing )
+{
+	char allowed[MAXHOLES];		// Moves allowed
+	size_t moves = game.MovesAllowed (allowed, playing);
+	char noisy[MAXHOLES];		// Bonus moves and captures
+	int gain[MAXHOLES];		// Seeds captures score, bonus moves 0
+	size_t loud = 0;
+	size_t m, o;
+
+	STAT(stats.quiesce++);
+	int stand = EvaluateGame<Eval> (game, player);
+	if ((moves == 0) || (qdepth <= 0)) {
+		STAT(stats.leaves++);
+		return(stand);
+	}
+	if (OutOfTime()) return(0);	// Result thrown away
+
+	int maxing = (playing == player);
+	if (maxing ? (stand >= beta) : (stand <= alpha)) {
+		STAT(stats.standpats++);
+		return(stand);		// Quiet enough already
+	}
+	if (maxing && (stand > alpha)) alpha = stand;
+	if (!maxing && (stand < beta)) beta = stand;
+
+	for (m = 0; m < moves; m++) {	// Bonus moves, captures by size
+		int hole = G::ChooseHole (playing, allowed[m]);
+		int score;
+		if (game.MoveEnd (playing, hole) == G::WELL) {
+			score = 0;
+		} else {
+			int captures = game.MoveCaptures (playing, hole);
+			if (captures == 0) continue;  // Quiet move
+			score = captures + 1 + (hole + game.Seeds(playing,hole)) / G::CYCLE;
+			if (maxing ? (stand + score + DELTAMARGIN <= alpha) :
+				     (stand - score - DELTAMARGIN >= beta)) {
+				continue;	// Cannot reach window
+			}
+		}
+		for (o = loud; (o > 0) && (gain[o-1] > 0) && ((score == 0) || (gain[o-1] < score)); o--) {
+			noisy[o] = noisy[o-1];
+			gain[o] = gain[o-1];
+		}
+		noisy[o] = allowed[m];
+		gain[o] = score;
+		loud++;
+	}
+
+	int best = stand;
+	for (m = 0; m < loud; m++) {
+		MoveUndo undo;
+		int endpt = game.KalahMove (playing, G::ChooseHole (playing, noisy[m]), undo);
+		nodes++;
+
+		char after[MAXHOLES];
+		int next = ((endpt == G::WELL) && (game.MovesAllowed (after, playing) > 0) ? playing : Opponent(playing));
+
+		int moveval = QUIESCE<Eval> (game, qdepth-1, alpha, beta, next);
+		game.UnmakeMove (undo);
+		if (stopped) return(0);
+		if (maxing) {
+			if (moveval > best) best = moveval;
+			if (best > alpha) alpha = best;
+		} else {
+			if (moveval < best) best = moveval;
+			if (best < beta) beta = best;
+		}
+		if (alpha >= beta) break;	// Cutoff
+	}
+	return(best);
 }
 
 // Ask player to move
-int Player::AskPlayer ( Game &game )
+template <class G>
+int KalahPlayer<G>::AskPlayer ( G &game )
 {
-	char allowed[6];		// Moves allowed
+	char allowed[MAXHOLES];		// Moves allowed
 	int moves = game.MovesAllowed (allowed, player);
 
 	if (moves <= 0) return(-1);	// No moves
 
 	int choice = -1;
 	do {
-		cout << "Player " << player << ": Select hole to move:";
+		context->Out() << "Player " << player << ": Select hole to move:";
 		int m;
 		for (m = 0; m < moves; m++) {
-			cout << " " << allowed[m];
+			context->Out() << " " << allowed[m];
 		}
-		cout << " -> ";
+		context->Out() << " -> ";
 
 		char hole;		// Hole to move
 		cin >> hole;
 		for (m = 0; m < moves; m++) {
 			if (allowed[m] == hole) {
-				choice = ChooseHole (player, hole);
+				choice = G::ChooseHole (player, hole);
 				break;
 			}
 		}
@@ -330,22 +1048,28 @@ int Player::AskPlayer ( Game &game )
 	return(choice);			// Move chosen
 }
 
-// Evaluate position in game
-int Player::EvaluateGame ( Game &game, int playing )
+// Solved endgame, if position is in endgame database
+//
+// All seeds end in the score wells, so the final score follows from the
+// net score still to be gained.
+template <class G>
+template <class Eval>
+int KalahPlayer<G>::SolvedGame ( G &game, int playing, int *score )
 {
-	if (evalfunc == EVALFUNCS[0]) {	// Evaluate by net score
-		return(game.NetScore(playing));
-	} else if (evalfunc == EVALFUNCS[1]) {  // Evaluate by player's score
-		return(game.MyScore(playing));
-	}
-	return(-1);
+	int gain;			// Net gain for player to move
+
+	if ((endgame == NULL) || !endgame->Probe (game, playing, &gain)) return(0);
+
+	int net = game.NetScore(player) + (playing == player ? gain : -gain);
+	*score = Eval::Final(game, net);	// Final score
+	return(1);
 }
 
 // Replay game moves
-void Player::Replay ( )
+void SearchContext::Replay ( )
 {
 	int p;
-        cout << "Game moves:" << endl;
+	*out << "Game moves:" << endl;
 	for (p = 1; p <= 2; p++) {
 		Replay(p);
 	}
@@ -361,14 +1085,18 @@ char RecChar ( int player, char rech )
 	}
 }
 
-void Player::Replay ( int player )
+void SearchContext::Replay ( int player )
 {
-        size_t movements = record.size();
+	size_t movements = record.size();
 	size_t r;
 
-	cout << player << ": ";
+	*out << player << ": ";
 	for (r = 0; r < movements; r++) {
-		cout << RecChar(player,record[r]);
+		*out << RecChar(player,record[r]);
 	}
-	cout << endl;
+	*out << endl;
 }
+
+// Players on every board variant
+#define PLAYER_VARIANT(n,s) template class KalahPlayer<KalahGame<n,s> >;
+KALAH_VARIANTS(PLAYER_VARIANT)
@@ -13,63 +13,340 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <atomic>
+#include <thread>
 
 using namespace std;
 
-const string ALGORITHMS[2] = { "minimax", "alphabeta" };
+const string ALGORITHMS[3] = { "minimax", "alphabeta", "pvs" };
 const string EVALFUNCS[2]  = { "netscore", "myscore" };
+const int HASHSIZE = 16;		// Default table megabytes
+const int TABLEDEPTH = 2;		// Shallowest search worth a table lookup
+const int MAXDEPTH = 99;		// Deepest search under time control
+const int MAXPLY = 2*(MAXDEPTH+1);	// Most moves searched, bonus moves included
+const int MOVESTOGO = 20;		// Moves the game clock is shared over
+const double MINMOVETIME = 0.001;	// Seconds per move once the clock is used up
+const int CHECKNODES = 1024;		// Nodes between time checks
+const int MAXTHREADS = 256;		// Most search threads per move
+const int ASPIRATION = 4;		// Root window either side of last score
+const int QUIESCEPLIES = 8;		// Most quiescence plies past the depth
+const int DELTAMARGIN = 2;		// Capture gain short of window still tried
+static_assert(STATPLIES == MAXDEPTH+1, "statistics count every ply");
 
-typedef vector<char> Moves;
+const int ORDERHASH = 1 << 20;		// Move ordering: table's best move
+const int ORDERBONUS = 1 << 19;		// Ends in score well
+const int ORDERCAPTURE = 1 << 18;	// Captures, plus seeds captured
+const int ORDERKILLER = 1 << 17;	// Killer move, history is below
 
-// Kalah Player 
-class Player {
+// Search policies: algorithm planning the move.  Principal variation
+// search is alpha-beta searching all but the first move with a null
+// window, and the root with a window round the last score.
+struct MinimaxSearch { static const int alphabeta = 0, pvs = 0; };
+struct AlphaBetaSearch { static const int alphabeta = 1, pvs = 0; };
+struct PVSSearch { static const int alphabeta = 1, pvs = 1; };
+
+// Evaluation policies: position's value to player, and the value of a
+// finished game from player's net score
+struct NetScoreEval {
+	template <class G>
+	static inline int Evaluate ( G &game, int player ) { return(game.NetScore(player)); }
+	template <class G>
+	static inline int Final ( G &game, int net ) { return(net); }
+};
+struct MyScoreEval {
+	template <class G>
+	static inline int Evaluate ( G &game, int player ) { return(game.MyScore(player)); }
+	template <class G>
+	static inline int Final ( G &game, int net ) { return((G::ALLSEEDS + net) / 2); }
+};
+
+// Pondering on the opponent's turn
+enum Ponder { PONDER_NONE, PONDER_ON, PONDER_HIT, PONDER_MISS };
+
+// Called at the search's time checks, every CHECKNODES nodes; nonzero
+// stops the search.  A scheduler can suspend the search inside it.
+typedef int (*SearchYield) ( void *arg );
+
+// Limits on planning a move
+typedef struct {
+	int depth;			// Deepest search
+	double movetime;		// Seconds per move, 0 no limit
+	double gametime;		// Seconds per player per game, 0 no limit
+	long nodes;			// Nodes per move, 0 no limit
+	int threads;			// Search threads per move
+} SearchLimits;
+
+// What one game's players share: game nodes generated, moves played
+// and where moves are shown.  Nothing is static, so any number of games
+// can run in one process, on any threads.
+class SearchContext {
+public:
+	SearchContext ( ostream &o = cout ) { nodes = 0; out = &o; }
+
+	// Game nodes generated, searching and playing
+	inline long Nodes ( ) { return(nodes); }
+	inline void AddNodes ( long n ) { nodes += n; }
+
+	// Where moves and boards are shown
+	inline ostream &Out ( ) { return(*out); }
+
+	// Record player move
+	inline void RecordMove ( char mv ) { record.push_back(mv); }
+	inline int Records ( ) { return(record.size()); }
+	inline void ClearRecord ( ) { record.clear(); }
+	inline char Recorded ( int r ) { return(record[r]); }
+	void Replay ( );
+	void Replay ( int player );
+
+private:
+	long nodes;			// Game nodes generated
+	ostream *out;			// Output sink
+	vector<char> record;		// Record of moves
+};
+
+// Kalah Player on board G
+//
+// A player searches in its own table and counts its own nodes.  Players
+// of one game share a SearchContext; a player given none has its own.
+template <class G>
+class KalahPlayer {
 public:
 	// Initialize Player
-	Player ( char *f, int p );
-	Player ( string a, string f, int p );
+	KalahPlayer ( char *f, int p, int v = 1, SearchContext *c = NULL );
+	KalahPlayer ( string a, string f, int p, int v = 1, int h = HASHSIZE, int q = 0, SearchContext *c = NULL );
+	KalahPlayer ( KalahPlayer &main, int helper, atomic<int> *abandon );
+	~KalahPlayer ( );
 
 	// Who is playing?
 	inline int Who ( ) { return(player); }
 
+	// Game's nodes, moves and output, shared with the other player
+	inline SearchContext &Context ( ) { return(*context); }
+
+	// Algorithm and evaluation function, as algorithm/evalfunc
+	inline string Config ( ) { return(algorithm + "/" + evalfunc); }
+
 	// Take a player's turn
-	int TakeTurn ( Game &game, int depth );
+	int TakeTurn ( G &game, SearchLimits &limits );
 
-	// Record player move
-	inline void RecordMove ( char mv ) { record.push_back(mv); }
-	static inline int Records ( ) { return(record.size()); }
-	static void Replay ( );
-	static void Replay ( int player );
+	// Search the position the best line expects after the opponent's
+	// turn, until the opponent has moved
+	void StartPonder ( G game, SearchLimits &limits );
+
+	// Stop pondering, unless hit: the opponent played the turn expected,
+	// so the ponder search goes on as this turn's search.  Nonzero if hit.
+	int StopPonder ( int hit );
+
+	// Plan player's move without making it, returning its score
+	inline int Think ( G &game, SearchLimits &limits, Moves &movements ) {
+		return(MOVE_GEN (game, limits, movements));
+	}
+
+	// Positions searched, kept across turns
+	inline TransTable *Table ( ) { return(table); }
+
+	// Search in a table shared with other players of the same side
+	void ShareTable ( TransTable *t );
+
+	// Let a scheduler suspend or stop the search at its time checks.
+	// Time suspended does not count against the move's time.
+	inline void SetYield ( SearchYield y, void *arg ) { yield = y; yieldarg = arg; }
+
+	// Solved endgames to look up instead of searching
+	inline void SetEndgame ( EndgameDB *e ) { endgame = e; }
+
+	// Opening moves to look up instead of searching
+	inline void SetBook ( OpeningBook *b ) { book = b; }
+	inline int BookMoves ( ) { return(bookmoves); }
+
+	// Score the search gave last turn's move, unless from book
+	inline int TurnScore ( ) { return(turnscore); }
+	inline int TurnFromBook ( ) { return(turnbook); }
+
+	// Depth the last search finished, and its score
+	inline int TurnDepth ( ) { return(turndepth); }
+	inline int DepthScore ( ) { return(lastscore); }
+
+	// Search statistics of all turns, helper threads included
+	inline const SearchStats &Stats ( ) { return(stats); }
+
+	// Table lookups, and how many found the position
+	inline long TableProbes ( ) { return(stats.probes); }
+	inline long TableHits ( ) { return(stats.hits); }
+
+	// Best line of moves the last search expected, bonus moves included
+	inline int LineLength ( ) { return(linelength); }
+	inline char LineMove ( int t ) { return(line[t]); }
+
+	// Cutoffs in search, and how many came from the first move tried
+	inline long Cutoffs ( ) { return(stats.cutoffs); }
+	inline long FirstCutoffs ( ) { return(stats.cutoffat[0]); }
+
+	// Turns after pondering, and how many the opponent played as expected
+	inline long Ponders ( ) { return(stats.ponders); }
+	inline long PonderHits ( ) { return(stats.ponderhits); }
 
 private:
 	string algorithm;		// Strategy algorithm
 	string evalfunc;		// Evaluation function
 	int player;			// Player id
+	SearchContext *context;		// Game's nodes, moves and output
+	SearchContext owncontext;	// Context when none given
+	long nodes;			// Game nodes this player searched
+	int hashsize;			// Table megabytes
+	int quiesce;			// Quiescence plies, 0 none
+	TransTable *table;		// Transposition table
+	int owntable;			// Table freed with player?
+	EndgameDB *endgame;		// Solved endgames, shared
+	OpeningBook *book;		// Opening moves, shared
+	int bookmoves;			// Turns played from book
+	int turnscore;			// Search score of last turn
+	int turnbook;			// Last turn played from book?
+	int turndepth;			// Depth last search finished
+	int rootdepth;			// Depth search started at
+	int lastscore;			// Score of last search finished
+	int haslast;			// Any search finished yet?
+
+	int helper;			// Helper thread number, 0 main search
+	atomic<int> *abandon;		// Main search done, helpers stop
+	long helpnodes;			// Nodes helper searched
+
+	double clockused;		// Seconds of game clock used
+	struct timeval searchstart;	// When search started
+	double budget;			// Seconds for this move, 0 no limit
+	long nodelimit;			// Nodes for this move, 0 no limit
+	long startnodes;		// Game nodes when search started
+	int checknodes;			// Countdown to next time check
+	int stopped;			// Search out of time or nodes
+
+	thread ponderer;		// Searches during opponent's turn
+	atomic<int> ponderstate;	// Pondering, hit or missed
+	int ponderwait;			// Ponder search waiting to start its limits
+	G ponderpos;			// Position pondered on
+	Moves pondermoves;		// Ponder search's turn
+	int ponderscore;		// and its score
+	double ponderbudget;		// Seconds for turn pondered, 0 no limit
+	long pondernodelimit;		// Nodes for turn pondered, 0 no limit
+	long ponderfrom;		// Nodes when pondering started
+	struct timeval hitstart;	// When the opponent played as expected
 
-	static Moves record;		// Record of moves
+	SearchYield yield;		// Scheduler's hook, NULL none
+	void *yieldarg;
+	double pausedsecs;		// Seconds suspended this move
+
+	char killers[MAXPLY][2];	// Moves that cut off, per ply
+	int history[2][MAXHOLES];	// Cutoff history per player hole
+	SearchStats stats;		// Search statistics
+
+	int verbose;			// Show moves on context's output?
+
+	// Search specialised for algorithm and evalfunc, chosen once
+	typedef int (KalahPlayer::*SearchFunc) ( G &game, int depth, Moves &movements );
+	SearchFunc search;
+
+	// Principal variation, triangular: row ply holds the best line of
+	// moves from ply on, as found so far
+	char pv[MAXPLY][MAXPLY];
+	int pvlength[MAXPLY];		// End of each row's line
+	char line[MAXPLY];		// Line of last depth finished
+	int linelength;
+	int bonusat[MAXPLY];		// Bonus moves in the turn before each ply
 
 	// Search into planning move is deep enough?
-	inline int DEEP_ENOUGH ( int depth, int moves ) {
-		// Step search if depth done or no moves available
-		return((depth <= 0) || (moves == 0));
+	inline int DEEP_ENOUGH ( int depth, int ply, int moves ) {
+		// Step search if depth done, no moves available or no plies left
+		return((depth <= 0) || (moves == 0) || (ply >= MAXPLY-1));
 	}
 
 	// Plan player's move
-	void MOVE_GEN ( Game game, int depth, Moves &movements );
+	int MOVE_GEN ( G &game, SearchLimits &limits, Moves &movements );
+
+	// Helper thread searches alongside main search
+	void HelpSearch ( G game, int depth );
+
+	// Ponder thread searches position expected after opponent's turn
+	void PonderSearch ( G game, SearchLimits limits );
+
+	// Choose search for algorithm and evalfunc
+	void ChooseSearch ( );
+
+	// Search one depth for player's move
+	int SearchDepth ( G &game, int depth, Moves &movements );
+	template <class Search, class Eval>
+	int SearchWith ( G &game, int depth, Moves &movements );
+
+	// Move improves best line at ply
+	inline void UpdatePV ( int ply, char move ) {
+		int t;
+		pv[ply][ply] = move;
+		for (t = ply+1; t < pvlength[ply+1]; t++) {
+			pv[ply][t] = pv[ply+1][t];
+		}
+		pvlength[ply] = (pvlength[ply+1] > ply+1 ? pvlength[ply+1] : ply+1);
+	}
+
+	// Line from the table's move, where the table ends the search
+	inline void TableLine ( int ply, char move ) {
+		if (move == 0) return;
+		pv[ply][ply] = move;
+		pvlength[ply] = ply+1;
+	}
+
+	// Keep line of depth just finished
+	void SaveLine ( );
+
+	// Search must stop now?
+	int OutOfTime ( );
+
+	// Seconds searching this move, not counting time suspended
+	inline double SearchTime ( ) { return(TimeSince(&searchstart) - pausedsecs); }
+
+	// Look up position in table, counting lookups
+	inline int Probe ( HashKey key, TableEntry &entry ) {
+		STAT(stats.probes++);
+		if (!table->Probe (key, entry)) return(0);
+		STAT(stats.hits++);
+		return(1);
+	}
+
+	// Order moves to search the likeliest cutoff first
+	void OrderMoves ( G &game, int playing, char allowed[], size_t moves, int ply, char hashmove );
+
+	// Remember move that cut off search
+	void CutoffMove ( int playing, char move, size_t tried, int ply, int depth );
+
+	// Player to move after playing's move ended at endpt
+	int NextMover ( G &game, int playing, int endpt, int ply );
+
+	// Player's turn from the best line
+	void RootTurn ( G game, Moves &movements );
 
 	// Plan player's move using Minimax strategy
-	int MINMAX_AB ( Game &game, int depth, int player, Moves &movements );
+	template <class Eval>
+	int MINMAX_AB ( G &game, int depth, int ply, int player );
 
-	// Player has bonus move
-	void BonusMove ( Game &game, int playing, Moves &trymoves );
+	// Plan player's move using Alpha-Beta strategy, or principal
+	// variation search
+	template <class Search, class Eval>
+	int ALPHA_BETA_SEARCH ( G &game, int depth, int ply, int alpha, int beta, int player );
 
-	// Plan player's move using Alpha-Beta strategy
-	int ALPHA_BETA_SEARCH ( Game &game, int depth, int alpha, int beta, int player, Moves &movements );
+	// Search captures and bonus moves past the depth until quiet
+	template <class Eval>
+	int QUIESCE ( G &game, int qdepth, int alpha, int beta, int playing );
 
 	// Ask player to move
-	int AskPlayer ( Game &game );
+	int AskPlayer ( G &game );
 
 	// Evaluate position in game
-	int EvaluateGame ( Game &game, int playing );
+	template <class Eval>
+	inline int EvaluateGame ( G &game, int playing ) { return(Eval::Evaluate (game, playing)); }
+
+	// Solved endgame, if position is in endgame database
+	template <class Eval>
+	int SolvedGame ( G &game, int playing, int *score );
 };
 
+// Player on the standard board
+typedef KalahPlayer<Game> Player;
+
 #endif
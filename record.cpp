@@ -0,0 +1,198 @@
+
+/*
+ * Compile:
+ *    make kalah-replay
+ *
+ * Usage:
+ *    ./kalah -q -r games.kgr -d depth -1 player1.txt -2 player2.txt
+ *    ./kalah-replay [-g game] games.kgr
+ */
+
+#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "game.h"
+#include "record.h"
+
+using namespace std;
+
+static_assert(sizeof(RecordGame) % 8 == 0, "turns follow game header aligned");
+static_assert(sizeof(RecordTurn) == 16, "turns packed");
+
+GameRecord::GameRecord ( )
+{
+	Start ("", "");
+}
+
+// Start recording a game between players
+void GameRecord::Start ( const string &config1, const string &config2, int h )
+{
+	holes = h;
+	memset (&head, 0, sizeof(head));
+	strncpy (head.config[0], config1.c_str(), RECORDCONFIG-1);
+	strncpy (head.config[1], config2.c_str(), RECORDCONFIG-1);
+	turns.clear();
+	sown.clear();
+}
+
+// Player's turn sowing holes (move letters)
+void GameRecord::AddTurn ( int player, const char letters[], int moves, int score, long nodes, double secs )
+{
+	RecordTurn turn;
+	int m;
+
+	turn.nodes = nodes;
+	turn.secs = secs;
+	turn.score = score;
+	turn.player = player;
+	turn.moves = moves;
+	turns.push_back(turn);
+	for (m = 0; m < moves; m++) {	// Letters run down from last hole
+		sown.push_back(player == 1 ? 'a'+holes-1 - letters[m] : holes-1 - (letters[m]-'A'));
+	}
+}
+
+RecordWriter::RecordWriter ( )
+{
+	out = NULL;
+}
+
+RecordWriter::~RecordWriter ( )
+{
+	if (out != NULL) fclose (out);
+}
+
+// Open file to append games on a board of holes and seeds to, 0 when
+// ready
+int RecordWriter::Open ( const char *file, int holes, int initseeds )
+{
+	out = fopen (file, "a+b");
+	if (out == NULL) {
+		cerr << "ERROR: Unable to write game records " << file << "." << endl;
+		return(1);
+	}
+	buffer.resize(RECORDBUFFER);
+	setvbuf (out, &buffer[0], _IOFBF, buffer.size());
+
+	RecordHeader header;
+	int read = (fread (&header, sizeof(header), 1, out) == 1);
+	fseek (out, 0, SEEK_END);
+	if (ftell (out) == 0) {		// New file
+		memcpy (header.magic, RECORDMAGIC, sizeof(header.magic));
+		header.holes = holes;
+		header.initseeds = initseeds;
+		if (fwrite (&header, sizeof(header), 1, out) != 1) return(2);
+	} else if (!read || (memcmp (header.magic, RECORDMAGIC, sizeof(header.magic)) != 0) ||
+		   (header.holes != holes) || (header.initseeds != initseeds)) {
+		cerr << "ERROR: " << file << " is not a game record file of this board." << endl;
+		fclose (out);
+		out = NULL;
+		return(3);
+	}
+	return(0);
+}
+
+// Append game, from any thread
+int RecordWriter::Write ( GameRecord &rec )
+{
+	size_t packsize = (rec.sown.size() + 1) / 2;
+	size_t size = sizeof(RecordGame) + rec.turns.size() * sizeof(RecordTurn) + packsize;
+	size_t padded = (size + 7) & ~(size_t)7;
+	unsigned char packed[(0xffff + 1) / 2 + 8];
+	size_t m;
+
+	if ((rec.turns.size() > 0xffff) || (rec.sown.size() > 0xffff)) return(1);
+	memset (packed, 0, padded - size + packsize);
+	for (m = 0; m < rec.sown.size(); m++) {
+		packed[m/2] |= rec.sown[m] << (4 * (m % 2));
+	}
+	rec.head.size = padded;
+	rec.head.turns = rec.turns.size();
+	rec.head.moves = rec.sown.size();
+
+	lock_guard<mutex> lock(writing);
+	if (out == NULL) return(2);
+	fwrite (&rec.head, sizeof(rec.head), 1, out);
+	if (rec.turns.size() > 0) {
+		fwrite (&rec.turns[0], sizeof(RecordTurn), rec.turns.size(), out);
+	}
+	fwrite (packed, 1, padded - size + packsize, out);
+	return(ferror (out) ? 3 : 0);
+}
+
+RecordReader::RecordReader ( )
+{
+	map = NULL;
+	mapsize = 0;
+	readto = 0;
+}
+
+RecordReader::~RecordReader ( )
+{
+	if (map != NULL) munmap (map, mapsize);
+}
+
+// Map record file, 0 when ready
+int RecordReader::Open ( const char *file )
+{
+	int fd = open (file, O_RDONLY);
+	if (fd < 0) {
+		cerr << "ERROR: Unable to open game records " << file << "." << endl;
+		return(1);
+	}
+
+	struct stat st;
+	if ((fstat (fd, &st) != 0) || (st.st_size < (off_t)sizeof(RecordHeader))) {
+		cerr << "ERROR: Game records " << file << " too short." << endl;
+		close (fd);
+		return(2);
+	}
+
+	mapsize = st.st_size;
+	map = mmap (NULL, mapsize, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);			// Mapping stays
+	if (map == MAP_FAILED) {
+		cerr << "ERROR: Unable to map game records " << file << "." << endl;
+		map = NULL;
+		return(3);
+	}
+	madvise (map, mapsize, MADV_SEQUENTIAL);
+
+	RecordHeader *header = (RecordHeader *)map;
+	if ((memcmp (header->magic, RECORDMAGIC, sizeof(header->magic)) != 0) ||
+	    (header->holes < 1) || (header->holes > MAXHOLES) || (header->initseeds < 1)) {
+		cerr << "ERROR: " << file << " is not a Kalah game record file." << endl;
+		munmap (map, mapsize);
+		map = NULL;
+		return(4);
+	}
+	return(0);
+}
+
+// Game at offset, if it fits in the mapping
+const RecordGame *RecordReader::GameAt ( size_t offset )
+{
+	if ((map == NULL) || (offset + sizeof(RecordGame) > mapsize)) return(NULL);
+
+	const RecordGame *game = (const RecordGame *)((char *)map + offset);
+	size_t need = sizeof(RecordGame) + game->turns * sizeof(RecordTurn) + (game->moves + 1) / 2;
+	if ((game->size < need) || (offset + game->size > mapsize)) return(NULL);  // Cut short
+	readto = offset + game->size;
+	return(game);
+}
+
+// First game, NULL if none
+const RecordGame *RecordReader::First ( )
+{
+	readto = sizeof(RecordHeader);
+	return(GameAt (sizeof(RecordHeader)));
+}
+
+// Game after game, NULL at end
+const RecordGame *RecordReader::Next ( const RecordGame *game )
+{
+	return(GameAt ((const char *)game - (const char *)map + game->size));
+}
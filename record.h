@@ -0,0 +1,138 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+/*
+ * Compile:
+ *    make kalah-replay
+ *
+ * Usage:
+ *    ./kalah -q -r games.kgr -d depth -1 player1.txt -2 player2.txt
+ *    ./kalah-tournament -c configs.txt -R games.kgr
+ *    ./kalah-replay [-g game] games.kgr
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+
+using namespace std;
+
+const char RECORDMAGIC[8] = { 'K','A','L','A','H','G','R','1' };
+const int RECORDCONFIG = 30;		// Config name bytes per player
+const int RECORDNOSCORE = -32768;	// Turn not searched: book or random
+const int RECORDBUFFER = 1 << 20;	// Bytes buffered by writer
+
+// Game record file header, followed by games
+typedef struct {
+	char magic[8];			// RECORDMAGIC
+	int holes;			// Holes per player
+	int initseeds;			// Seeds to start in holes
+} RecordHeader;
+
+// Game in record file, followed by its turns, then the holes sown
+// packed two to a byte, then padding to 8 bytes
+typedef struct {
+	unsigned int size;		// Bytes of game, turns and holes
+	unsigned short turns;		// Turns that follow
+	unsigned short moves;		// Holes sown in all turns
+	signed char winner;		// Player who won, 0 tie
+	unsigned char stores[2];	// Final score wells
+	unsigned char pad;
+	char config[2][RECORDCONFIG];	// Players' configurations
+} RecordGame;
+
+// Turn in game record
+typedef struct {
+	long long nodes;		// Game nodes searched
+	float secs;			// Seconds taken
+	short score;			// Search score, RECORDNOSCORE if none
+	unsigned char player;		// Player moving
+	unsigned char moves;		// Holes sown, bonus moves included
+} RecordTurn;
+
+// Game being recorded
+class GameRecord {
+public:
+	GameRecord ( );
+
+	// Start recording a game between players on a board of holes
+	void Start ( const string &config1, const string &config2, int h = 6 );
+
+	// Player's turn sowing holes (move letters)
+	void AddTurn ( int player, const char letters[], int moves, int score, long nodes, double secs );
+
+	// Game over
+	template <class G>
+	void Finish ( G &game ) {
+		head.stores[0] = game.Score(1);
+		head.stores[1] = game.Score(2);
+		head.winner = (game.Score(1) == game.Score(2) ? 0 : (game.Score(1) > game.Score(2) ? 1 : 2));
+	}
+
+	int holes;			// Holes per player
+	RecordGame head;		// Game header
+	vector<RecordTurn> turns;	// Turns in order
+	vector<unsigned char> sown;	// Holes sown, unpacked
+};
+
+// Streaming game record writer, appends to file
+class RecordWriter {
+public:
+	RecordWriter ( );
+	~RecordWriter ( );
+
+	// Open file to append games on a board of holes and seeds to, 0
+	// when ready.  A file holds games of one board.
+	int Open ( const char *file, int holes = 6, int initseeds = INITSEEDS );
+
+	// Append game, from any thread
+	int Write ( GameRecord &rec );
+
+private:
+	FILE *out;			// Record file
+	vector<char> buffer;		// Output buffer
+	mutex writing;			// One game written at a time
+};
+
+// Game record file, memory mapped read-only
+class RecordReader {
+public:
+	RecordReader ( );
+	~RecordReader ( );
+
+	// Map record file, 0 when ready
+	int Open ( const char *file );
+
+	// Board the games were played on
+	inline int Holes ( ) { return(((const RecordHeader *)map)->holes); }
+	inline int InitSeeds ( ) { return(((const RecordHeader *)map)->initseeds); }
+
+	// First game, then the game after each, NULL at end
+	const RecordGame *First ( );
+	const RecordGame *Next ( const RecordGame *game );
+
+	// Game's turns
+	inline const RecordTurn *Turns ( const RecordGame *game ) {
+		return((const RecordTurn *)(game + 1));
+	}
+
+	// Game's m'th hole sown
+	inline int Hole ( const RecordGame *game, int m ) {
+		const unsigned char *packed = (const unsigned char *)(Turns(game) + game->turns);
+		return((m % 2) == 0 ? packed[m/2] & 0xf : packed[m/2] >> 4);
+	}
+
+	// Bytes after the last game read that hold no whole game
+	inline size_t Unread ( ) { return(mapsize - readto); }
+
+private:
+	void *map;			// File mapping
+	size_t mapsize;			// Bytes mapped
+	size_t readto;			// End of last game read
+
+	// Game at offset, if it fits in the mapping
+	const RecordGame *GameAt ( size_t offset );
+};
+
+#endif
@@ -0,0 +1,148 @@
+
+/*
+ * Compile:
+ *    make kalah-replay
+ *
+ * Usage:
+ *    ./kalah-replay [-g game] games.kgr
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/time.h>
+#include "game.h"
+#include "record.h"
+
+using namespace std;
+
+// Correct usage
+void Usage ( char *argv[] )
+{
+	cerr << "Usage: " << argv[0] << " [-g game] games.kgr" << endl;
+}
+
+// Replay game through KalahMove, showing boards if asked, 0 if the
+// moves are legal and give the recorded final score
+template <class G>
+int ReplayGame ( RecordReader &records, const RecordGame *rec, int show, long *moves )
+{
+	const RecordTurn *turns = records.Turns(rec);
+	G game;
+	int playing = 1;		// Player 1 starts
+	int m = 0;			// Holes sown so far
+	int t;
+
+	if (show) {
+		cout << "Player 1: " << rec->config[0] << endl;
+		cout << "Player 2: " << rec->config[1] << endl;
+		game.Display();
+	}
+	for (t = 0; t < rec->turns; t++) {
+		const RecordTurn &turn = turns[t];
+		int endpt = G::WELL;
+		int b;
+
+		if ((turn.player != playing) || (turn.moves == 0)) return(1);
+		for (b = 0; b < turn.moves; b++, m++) {
+			if (endpt != G::WELL) return(2);	// Turn went on without bonus
+			int hole = records.Hole (rec, m);
+			if ((hole >= G::WELL) || (game.Seeds (playing, hole) == 0)) return(3);
+			endpt = game.KalahMove (playing, hole);
+			(*moves)++;
+		}
+
+		char allowed[MAXHOLES];
+		if ((endpt == G::WELL) && (game.MovesAllowed (allowed, playing) > 0)) return(4);  // Bonus move missing
+
+		if (show) {
+			cout << endl << "Turn " << (t+1) << ": player " << playing << " moves ";
+			for (b = m - turn.moves; b < m; b++) {
+				cout << G::MoveHole (playing, records.Hole (rec, b));
+			}
+			if (turn.score != RECORDNOSCORE) cout << ", score " << turn.score;
+			cout << ", " << turn.nodes << " nodes, " << turn.secs << " secs" << endl;
+			game.Display();
+		}
+		playing = Opponent(playing);	// Bonus moves stay in the turn
+	}
+
+	char allowed[MAXHOLES];
+	if (game.MovesAllowed (allowed, playing) == 0) {  // Game over
+		int opp = Opponent(playing);
+		game.Score(opp, game.Gather(opp));  // Opponent gets seeds
+	}
+	if ((game.Score(1) != rec->stores[0]) || (game.Score(2) != rec->stores[1])) return(5);
+	if (show) {
+		cout << endl << "Final score " << game.Score(1) << " to " << game.Score(2) << "." << endl;
+	}
+	return(0);
+}
+
+// Replay every game on board G, showing game show
+template <class G>
+int ReplayGames ( RecordReader &records, long show )
+{
+	struct timeval starter;
+	gettimeofday (&starter, NULL);
+	long games = 0, turns = 0, moves = 0, bad = 0;
+	long wins[3] = { 0, 0, 0 };
+	const RecordGame *rec;
+	for (rec = records.First(); rec != NULL; rec = records.Next(rec)) {
+		games++;
+		int err = ReplayGame<G> (records, rec, games == show, &moves);
+		if (err) {
+			cerr << "Game " << games << " does not replay (error " << err << ")." << endl;
+			bad++;
+		}
+		turns += rec->turns;
+		if ((rec->winner >= 0) && (rec->winner <= 2)) wins[rec->winner]++;
+	}
+	double secs = TimeSince(&starter);
+
+	cout << "Replayed " << games << " games, " << turns << " turns, " << moves << " moves in "
+	     << secs << " secs, " << (long)(secs > 0 ? moves / secs : 0) << " moves/sec." << endl;
+	cout << "Player 1 won " << wins[1] << ", player 2 won " << wins[2] << ", " << wins[0] << " tied." << endl;
+	if (records.Unread() > 0) {
+		cout << records.Unread() << " bytes at end hold no whole game." << endl;
+		bad++;
+	}
+	if (bad > 0) {
+		cout << bad << " games did not replay or were cut short." << endl;
+		return(3);
+	}
+	return(0);
+}
+
+int main ( int argc, char *argv[] )
+{
+	long show = 0;			// Game to show, 0 none
+	int opt;
+
+	while ((opt = getopt (argc, argv, "g:")) != -1) {
+		switch (opt) {
+		case 'g':		// Show game
+			show = atol(optarg);
+			break;
+
+		default:
+			Usage(argv);
+			return(1);
+		}
+	}
+	if (optind != argc - 1) {
+		Usage(argv);
+		return(1);
+	}
+
+	RecordReader records;
+	if (records.Open (argv[optind])) return(2);
+
+#define REPLAY_VARIANT(n,s) \
+	if ((records.Holes() == n) && (records.InitSeeds() == s)) { \
+		return(ReplayGames<KalahGame<n,s> > (records, show)); \
+	}
+	KALAH_VARIANTS(REPLAY_VARIANT)
+	cerr << "Kalah(" << records.Holes() << "," << records.InitSeeds() << ") games cannot be replayed." << endl;
+	return(2);
+}
@@ -0,0 +1,128 @@
+
+/*
+ * Compile:
+ *    make
+ *
+ * Usage:
+ *    ./kalah -s stats.json -d depth -1 player1.txt -2 player2.txt
+ */
+
+#include <iostream>
+#include <cstring>
+#include "game.h"
+#include "stats.h"
+
+using namespace std;
+
+// Start counting again
+void SearchStats::Clear ( )
+{
+	memset (nodes, 0, sizeof(nodes));
+	leaves = endgames = 0;
+	quiesce = standpats = 0;
+	cutoffs = 0;
+	researches = aspirations = 0;
+	memset (cutoffat, 0, sizeof(cutoffat));
+	memset (chains, 0, sizeof(chains));
+	probes = hits = 0;
+	ponders = ponderhits = 0;
+	memset (iterations, 0, sizeof(iterations));
+	memset (iternodes, 0, sizeof(iternodes));
+	memset (itersecs, 0, sizeof(itersecs));
+}
+
+// Add another thread's statistics
+void SearchStats::Merge ( const SearchStats &s )
+{
+	int i;
+
+	for (i = 0; i < STATPLIES; i++) {
+		nodes[i] += s.nodes[i];
+		iterations[i] += s.iterations[i];
+		iternodes[i] += s.iternodes[i];
+		itersecs[i] += s.itersecs[i];
+	}
+	for (i = 0; i < 6; i++) {
+		cutoffat[i] += s.cutoffat[i];
+	}
+	for (i = 0; i < STATCHAINS; i++) {
+		chains[i] += s.chains[i];
+	}
+	leaves += s.leaves;
+	endgames += s.endgames;
+	quiesce += s.quiesce;
+	standpats += s.standpats;
+	cutoffs += s.cutoffs;
+	researches += s.researches;
+	aspirations += s.aspirations;
+	probes += s.probes;
+	hits += s.hits;
+	ponders += s.ponders;
+	ponderhits += s.ponderhits;
+}
+
+// Positions searched, all plies
+long SearchStats::Nodes ( ) const
+{
+	long total = 0;
+	int i;
+	for (i = 0; i < STATPLIES; i++) {
+		total += nodes[i];
+	}
+	return(total);
+}
+
+// Write counts up to the last non-zero one as a JSON array
+static void WriteArray ( ostream &out, const long counts[], int size )
+{
+	int last = size;
+	int i;
+
+	while ((last > 0) && (counts[last-1] == 0)) last--;
+	out << "[";
+	for (i = 0; i < last; i++) {
+		out << (i > 0 ? ", " : "") << counts[i];
+	}
+	out << "]";
+}
+
+// Write statistics as a JSON object
+void SearchStats::WriteJSON ( ostream &out, const char *indent ) const
+{
+	int last = STATPLIES;
+	int i;
+
+	out << "{" << endl;
+	out << indent << "  \"nodes\": " << Nodes() << "," << endl;
+	out << indent << "  \"nodes_per_ply\": ";
+	WriteArray (out, nodes, STATPLIES);
+	out << "," << endl;
+	out << indent << "  \"leaves\": " << leaves << "," << endl;
+	out << indent << "  \"endgames\": " << endgames << "," << endl;
+	out << indent << "  \"quiescence\": " << quiesce << "," << endl;
+	out << indent << "  \"stand_pats\": " << standpats << "," << endl;
+	out << indent << "  \"cutoffs\": " << cutoffs << "," << endl;
+	out << indent << "  \"researches\": " << researches << "," << endl;
+	out << indent << "  \"aspiration_misses\": " << aspirations << "," << endl;
+	out << indent << "  \"cutoffs_by_move\": ";
+	WriteArray (out, cutoffat, 6);
+	out << "," << endl;
+	out << indent << "  \"bonus_chains\": ";
+	WriteArray (out, chains, STATCHAINS);
+	out << "," << endl;
+	out << indent << "  \"table_probes\": " << probes << "," << endl;
+	out << indent << "  \"table_hits\": " << hits << "," << endl;
+	out << indent << "  \"ponders\": " << ponders << "," << endl;
+	out << indent << "  \"ponder_hits\": " << ponderhits << "," << endl;
+
+	while ((last > 0) && (iterations[last-1] == 0)) last--;
+	out << indent << "  \"iterations\": [";
+	for (i = 1; i < last; i++) {
+		out << (i > 1 ? "," : "") << endl << indent << "    { \"depth\": " << i
+		    << ", \"searches\": " << iterations[i] << ", \"game_nodes\": " << iternodes[i]
+		    << ", \"secs\": " << itersecs[i] << " }";
+	}
+	if (last > 1) out << endl << indent << "  ";
+	out << "]" << endl;
+	out << indent << "}";
+}
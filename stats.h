@@ -0,0 +1,62 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+ * Compile:
+ *    make
+ *    make CPPFLAGS=-DNOSTATS		(statistics compiled out)
+ *
+ * Usage:
+ *    ./kalah -s stats.json -d depth -1 player1.txt -2 player2.txt
+ */
+
+#include <iostream>
+
+using namespace std;
+
+// Count search statistic, or nothing when compiled out
+#ifdef NOSTATS
+#define STAT(count)
+#else
+#define STAT(count) count
+#endif
+
+const int STATPLIES = 100;		// Plies counted, MAXDEPTH+1
+const int STATCHAINS = MAXCHAIN+1;	// Bonus chain lengths counted
+
+// Search statistics, kept per search thread and added together
+struct SearchStats {
+	long nodes[STATPLIES];		// Positions searched per turn of depth
+	long leaves;			// Positions evaluated
+	long quiesce;			// Positions searched past the depth
+	long standpats;			// Quiescence positions standing on their score
+	long endgames;			// Positions found in endgame database
+	long cutoffs;			// Cutoffs in search
+	long researches;		// Null window searches failed high, searched again
+	long aspirations;		// Root windows missed, searched again
+	long cutoffat[6];		// Cutoffs by index of move tried
+	long chains[STATCHAINS];	// Turns searched by bonus moves in them
+	long probes;			// Table lookups
+	long hits;			// Table lookups found
+	long ponders;			// Turns after pondering on opponent's turn
+	long ponderhits;		// Pondered on the position that came
+	long iterations[STATPLIES];	// Searches finished per depth
+	long iternodes[STATPLIES];	// Game nodes searching each depth
+	double itersecs[STATPLIES];	// Seconds searching each depth
+
+	SearchStats ( ) { Clear(); }
+
+	// Start counting again
+	void Clear ( );
+
+	// Add another thread's statistics
+	void Merge ( const SearchStats &s );
+
+	// Positions searched, all plies
+	long Nodes ( ) const;
+
+	// Write statistics as a JSON object
+	void WriteJSON ( ostream &out, const char *indent = "" ) const;
+};
+
+#endif
@@ -0,0 +1,129 @@
+
+/*
+ * Compile:
+ *    make
+ *
+ * Usage:
+ *    ./kalah -d depth -1 player1.txt -2 player2.txt
+ */
+
+#include <iostream>
+#include "game.h"
+#include "table.h"
+
+using namespace std;
+
+// Pack entry into a data word
+static HashKey Pack ( int score, char move, int depth, int bound, int age )
+{
+	return((HashKey)(unsigned short)score |
+	       ((HashKey)(unsigned char)move << 16) |
+	       ((HashKey)(unsigned char)depth << 24) |
+	       ((HashKey)(unsigned char)bound << 32) |
+	       ((HashKey)(unsigned char)age << 40));
+}
+
+// Table within memory budget in megabytes
+TransTable::TransTable ( int megabytes )
+{
+	unsigned long bytes = (unsigned long)megabytes << 20;
+
+	buckets = 0;
+	table = NULL;
+	if (bytes >= sizeof(TableSlot) * TABLEWAYS) {
+		buckets = 1;		// Largest power of 2 in budget
+		while (buckets * 2 * sizeof(TableSlot) * TABLEWAYS <= bytes) {
+			buckets *= 2;
+		}
+		table = new TableSlot[buckets * TABLEWAYS];
+	}
+	Clear();
+}
+
+TransTable::~TransTable ( )
+{
+	delete[] table;
+}
+
+// Forget all positions
+void TransTable::Clear ( )
+{
+	unsigned long e;
+	for (e = 0; e < buckets * TABLEWAYS; e++) {
+		table[e].check.store(0, memory_order_relaxed);
+		table[e].data.store(0, memory_order_relaxed);
+	}
+	age = 0;
+}
+
+// Read slot into entry, zero if empty or torn
+int TransTable::Load ( TableSlot *slot, TableEntry &entry )
+{
+	HashKey data = slot->data.load(memory_order_relaxed);
+	HashKey check = slot->check.load(memory_order_relaxed);
+
+	entry.key = check ^ data;
+	entry.score = (short)(data & 0xffff);
+	entry.move = (char)((data >> 16) & 0xff);
+	entry.depth = (data >> 24) & 0xff;
+	entry.bound = (data >> 32) & 0xff;
+	entry.age = (data >> 40) & 0xff;
+	return(entry.bound != BOUND_NONE);
+}
+
+// Look up position into entry, zero if not found
+int TransTable::Probe ( HashKey key, TableEntry &entry )
+{
+	if (buckets == 0) return(0);	// No table
+
+	TableSlot *bucket = &table[(key & (buckets-1)) * TABLEWAYS];
+	int w;
+
+	for (w = 0; w < TABLEWAYS; w++) {
+		if (Load (&bucket[w], entry) && (entry.key == key)) {
+			return(1);
+		}
+	}
+	return(0);
+}
+
+// Save position searched
+//
+// Replacement: the same position is always overwritten; otherwise the
+// entry left by an older search goes first, then the shallower one.
+void TransTable::Store ( HashKey key, int depth, int bound, int score, char move )
+{
+	if (buckets == 0) return;	// No table
+
+	TableSlot *bucket = &table[(key & (buckets-1)) * TABLEWAYS];
+	TableSlot *replace = &bucket[0];
+	TableEntry entry, old;		// Slot looked at, slot to replace
+	unsigned char now = age.load(memory_order_relaxed);
+	int w;
+
+	Load (replace, old);
+	for (w = 0; w < TABLEWAYS; w++) {
+		if (!Load (&bucket[w], entry) || (entry.key == key)) {
+			replace = &bucket[w];
+			old = entry;
+			break;
+		}
+		int stale = (entry.age != now);
+		int replacestale = (old.age != now);
+		if ((stale && !replacestale) ||
+		    ((stale == replacestale) && (entry.depth < old.depth))) {
+			replace = &bucket[w];
+			old = entry;
+		}
+	}
+
+	if ((old.bound != BOUND_NONE) && (old.key == key)) {
+		// Keep a deeper result for the same position from this search
+		if ((old.age == now) && (old.depth > depth)) return;
+		if (move == 0) move = old.move;  // Keep best move known
+	}
+
+	HashKey data = Pack (score, move, depth, bound, now);
+	replace->data.store(data, memory_order_relaxed);
+	replace->check.store(key ^ data, memory_order_relaxed);
+}
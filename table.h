@@ -0,0 +1,70 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+/*
+ * Compile:
+ *    make
+ *
+ * Usage:
+ *    ./kalah -d depth -1 player1.txt -2 player2.txt
+ */
+
+#include <atomic>
+
+using namespace std;
+
+// Kind of score stored
+enum Bound { BOUND_NONE, BOUND_EXACT, BOUND_LOWER, BOUND_UPPER };
+
+// Transposition table entry
+struct TableEntry {
+	HashKey key;			// Position key
+	short score;			// Score searched
+	char move;			// Best move found
+	unsigned char depth;		// Depth searched
+	unsigned char bound;		// Exact, lower or upper bound
+	unsigned char age;		// Search that stored entry
+};
+
+// Table slot shared between search threads without locks: the entry is
+// packed into one data word and the key is kept XORed with it, so a
+// slot torn by two threads storing at once no longer matches its key.
+struct TableSlot {
+	atomic<HashKey> check;		// Key ^ data
+	atomic<HashKey> data;		// Packed entry
+};
+
+const int TABLEWAYS = 2;		// Entries per bucket
+
+// Transposition table of searched positions
+class TransTable {
+public:
+	// Table within memory budget in megabytes
+	TransTable ( int megabytes );
+	~TransTable ( );
+
+	// Table in use?
+	inline int Size ( ) { return(buckets * TABLEWAYS); }
+
+	// New search starts: older entries get replaced first
+	inline void NewSearch ( ) { age.fetch_add(1, memory_order_relaxed); }
+
+	// Look up position into entry, zero if not found
+	int Probe ( HashKey key, TableEntry &entry );
+
+	// Save position searched
+	void Store ( HashKey key, int depth, int bound, int score, char move );
+
+	// Forget all positions
+	void Clear ( );
+
+private:
+	TableSlot *table;		// Buckets of entries
+	unsigned long buckets;		// Buckets in table, power of 2
+	atomic<unsigned char> age;	// Current search, any searcher starts one
+
+	// Read slot into entry, zero if empty or torn
+	int Load ( TableSlot *slot, TableEntry &entry );
+};
+
+#endif
@@ -0,0 +1,120 @@
+
+/*
+ * Compile:
+ *    make libkalah.a
+ *
+ * Usage:
+ *    SearchTask<Game> task(player, game, limits);
+ *    while (!task.Resume (TASKSLICE)) { ... }
+ */
+
+#include <iostream>
+#include <cstdint>
+#include <cctype>
+#include <cassert>
+#include "game.h"
+#include "table.h"
+#include "endgame.h"
+#include "book.h"
+#include "stats.h"
+#include "player.h"
+#include "task.h"
+
+using namespace std;
+
+template <class G>
+SearchTask<G>::SearchTask ( KalahPlayer<G> &p, G g, SearchLimits &l, atomic<int> *stop )
+	: player(p), game(g)
+{
+	limits = l;
+	limits.threads = 1;		// Helpers could not be suspended with it
+	stack = new char[TASKSTACK];
+	started = done = 0;
+	stopped = 0;
+	cancelled = (stop != NULL ? stop : &stopped);
+	slice = 0;
+	score = 0;
+}
+
+// A task suspended mid-search is cancelled and run to its end, so its
+// stack unwinds before it is freed
+template <class G>
+SearchTask<G>::~SearchTask ( )
+{
+	if (started && !done) {
+		Cancel();
+		while (!Resume (0)) { }
+	}
+	delete[] stack;
+}
+
+// Task's entry, given this task's address in two halves
+template <class G>
+void SearchTask<G>::Start ( unsigned int hi, unsigned int lo )
+{
+	SearchTask *t = (SearchTask *)(((uintptr_t)hi << 32) | (uintptr_t)lo);
+
+	t->player.SetYield (Yield, t);
+	t->score = t->player.Think (t->game, t->limits, t->movements);
+	t->player.SetYield (NULL, NULL);
+	t->done = 1;			// Returns to caller by uc_link
+}
+
+// Search's time check: suspend once slice is used up
+template <class G>
+int SearchTask<G>::Yield ( void *arg )
+{
+	SearchTask *t = (SearchTask *)arg;
+
+	if (!*t->cancelled && (TimeSince(&t->slicestart) >= t->slice)) {
+		swapcontext (&t->task, &t->caller);	// Until resumed
+	}
+	return(*t->cancelled);
+}
+
+// Run search for up to secs, nonzero once it is done
+template <class G>
+int SearchTask<G>::Resume ( double secs )
+{
+	if (done) return(1);
+
+	slice = secs;
+	gettimeofday (&slicestart, NULL);
+	if (!started) {
+		uintptr_t self = (uintptr_t)this;
+		getcontext (&task);
+		task.uc_stack.ss_sp = stack;
+		task.uc_stack.ss_size = TASKSTACK;
+		task.uc_link = &caller;
+		makecontext (&task, (void (*)())Start, 2, (unsigned int)(self >> 32), (unsigned int)self);
+		owner = this_thread::get_id();
+		started = 1;
+	}
+	assert(owner == this_thread::get_id());	// Stack holds this thread's state
+	swapcontext (&caller, &task);
+	return(done);
+}
+
+// Best turn found and its score: the search's once done, else the last
+// depth finished's, if any
+template <class G>
+int SearchTask<G>::Best ( Moves &best )
+{
+	int t;
+
+	if (done) {
+		best = movements;
+		return(score);
+	}
+	best.clear();
+	if (!started || (player.TurnDepth() == 0)) return(0);	// No depth finished yet
+	for (t = 0; (t < player.LineLength()) &&
+		    ((islower(player.LineMove(t)) != 0) == (player.Who() == 1)); t++) {
+		best.push_back(player.LineMove(t));
+	}
+	return(player.DepthScore());
+}
+
+// Tasks on every board variant
+#define TASK_VARIANT(n,s) template class SearchTask<KalahGame<n,s> >;
+KALAH_VARIANTS(TASK_VARIANT)
@@ -0,0 +1,82 @@
+#ifndef TASK_H
+#define TASK_H
+
+/*
+ * Compile:
+ *    make libkalah.a
+ *
+ * Usage:
+ *    SearchTask<Game> task(player, game, limits);
+ *    while (!task.Resume (TASKSLICE)) { ... }
+ */
+
+#include <atomic>
+#include <thread>
+#include <ucontext.h>
+#include <sys/time.h>
+
+using namespace std;
+
+const int TASKSTACK = 1 << 20;		// Stack bytes per search task
+const double TASKSLICE = 0.010;		// Seconds a task runs before yielding
+
+// Player's search run as a task on a stack of its own
+//
+// A scheduler resumes the task for slices of time, always on the thread
+// that first resumed it: the task's stack may hold the thread's own
+// state, such as errno, malloc's thread cache or a thread_local, which
+// would be wrong on another thread.  Resume checks this.  The search
+// suspends itself at its time checks once the slice is used up, so it
+// switches stacks, and so saves the signal mask, once a slice rather
+// than at every check.  Time suspended does not count against its move
+// time.  Cancelled, it stops at the next time check and keeps the move
+// of the last depth it finished.
+template <class G>
+class SearchTask {
+public:
+	SearchTask ( KalahPlayer<G> &p, G g, SearchLimits &l, atomic<int> *stop = NULL );
+	~SearchTask ( );
+
+	// Run search for up to secs, nonzero once it is done.  Only on the
+	// thread that first resumed it.
+	int Resume ( double secs );
+
+	// Stop search at its next time check; it finishes when next resumed.
+	// Setting the stop flag given does the same from any thread.
+	inline void Cancel ( ) { *cancelled = 1; }
+
+	// Search done?
+	inline int Done ( ) { return(done); }
+
+	// Best turn found and its score: the search's once done, else the
+	// last depth finished's, if any.  Only between slices.
+	int Best ( Moves &movements );
+
+	// Depth finished
+	inline int Depth ( ) { return(player.TurnDepth()); }
+
+private:
+	KalahPlayer<G> &player;		// Player searching
+	G game;				// Position searched
+	SearchLimits limits;		// Depth, time and nodes
+	char *stack;			// Task's own stack
+	ucontext_t task;		// Search, suspended
+	ucontext_t caller;		// Scheduler resuming it
+	thread::id owner;		// Thread it runs on
+	int started;			// Search begun?
+	int done;			// Search finished?
+	atomic<int> stopped;		// Own stop flag, unless given one
+	atomic<int> *cancelled;		// Stop at next time check
+	struct timeval slicestart;	// When slice began
+	double slice;			// Seconds in this slice
+	Moves movements;		// Turn searched, once done
+	int score;			// and its score
+
+	// Task's entry, given this task's address in two halves
+	static void Start ( unsigned int hi, unsigned int lo );
+
+	// Search's time check: suspend once slice is used up
+	static int Yield ( void *arg );
+};
+
+#endif
@@ -0,0 +1,460 @@
+
+/*
+ * Compile:
+ *    make kalah-tournament
+ *
+ * Usage:
+ *    ./kalah-tournament -c configs.txt [-g games] [-r plies] [-j threads] [-o results.csv] [-J results.json] [-R games.kgr]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include "game.h"
+#include "table.h"
+#include "endgame.h"
+#include "book.h"
+#include "stats.h"
+#include "player.h"
+#include "record.h"
+
+using namespace std;
+
+const int TOURNGAMES = 10;		// Default games per pairing
+const int TOURNPLIES = 2;		// Default random opening turns
+
+// Correct usage
+void Usage ( char *argv[] )
+{
+	cerr << "Usage: " << argv[0] << " -c configs.txt [-g games] [-r plies] [-j threads] [-o results.csv] [-J results.json] [-R games.kgr]" << endl;
+}
+
+// Player configuration
+typedef struct {
+	string name;			// Shown in results
+	string algorithm;		// Strategy algorithm
+	string evalfunc;		// Evaluation function
+	int hashsize;			// Table megabytes
+	int quiesce;			// Quiescence plies, 0 none
+	SearchLimits limits;		// Depth and time
+} PlayerConfig;
+
+// One game to play
+typedef struct {
+	int pairing;			// Pairing of configs
+	int first;			// Config playing first
+	int second;			// Config playing second
+	int opening;			// Random opening number
+} TournGame;
+
+// Totals for one side of a pairing
+typedef struct {
+	int wins;			// Games won
+	int draws;			// Games tied
+	int losses;			// Games lost
+	long margin;			// Sum of score margins
+	long moves;			// Moves searched
+	double nodes;			// Nodes searched
+	double secs;			// Seconds searched
+} TournTotals;
+
+// Read configuration matrix: each category lists the values to try, and
+// every combination becomes a player
+int ReadConfigs ( char *file, vector<PlayerConfig> &configs )
+{
+	vector<string> algorithms(1, ALGORITHMS[1]), evalfuncs(1, EVALFUNCS[0]);
+	vector<string> depths(1, "4"), movetimes(1, "0"), hashsizes(1, "16"), quiesces(1, "0");
+
+	ifstream conffile(file);
+	if (!conffile) {
+		cerr << "ERROR: Unable to read " << file << "." << endl;
+		return(1);
+	}
+
+	string line;
+	while (getline (conffile, line)) {
+		istringstream words(line);
+		string cat, val;
+		vector<string> vals;
+		if (!(words >> cat) || (cat[0] == '#')) continue;
+		while (words >> val) vals.push_back(val);
+		if (vals.empty()) {
+			cerr << "No values: " << cat << endl;
+			return(2);
+		}
+
+		if (cat == "algorithm") {
+			algorithms = vals;
+		} else if (cat == "evalfunc") {
+			evalfuncs = vals;
+		} else if (cat == "depth") {
+			depths = vals;
+		} else if (cat == "movetime") {
+			movetimes = vals;
+		} else if (cat == "hashsize") {
+			hashsizes = vals;
+		} else if (cat == "quiescence") {
+			quiesces = vals;
+		} else {
+			cerr << "Unknown category: " << cat << endl;
+			return(2);
+		}
+	}
+
+	size_t a, f, d, t, h, q;
+	for (a = 0; a < algorithms.size(); a++)
+	for (f = 0; f < evalfuncs.size(); f++)
+	for (d = 0; d < depths.size(); d++)
+	for (t = 0; t < movetimes.size(); t++)
+	for (h = 0; h < hashsizes.size(); h++)
+	for (q = 0; q < quiesces.size(); q++) {
+		PlayerConfig conf;
+		conf.algorithm = algorithms[a];
+		conf.evalfunc = evalfuncs[f];
+		conf.hashsize = atoi(hashsizes[h].c_str());
+		conf.quiesce = atoi(quiesces[q].c_str());
+		conf.limits.depth = atoi(depths[d].c_str());
+		conf.limits.movetime = ParseTime(movetimes[t].c_str());
+		conf.limits.gametime = 0;
+		conf.limits.nodes = 0;
+		conf.limits.threads = 1;
+
+		if (!((conf.algorithm == ALGORITHMS[0]) || (conf.algorithm == ALGORITHMS[1]) || (conf.algorithm == ALGORITHMS[2])) ||
+		    !((conf.evalfunc == EVALFUNCS[0]) || (conf.evalfunc == EVALFUNCS[1])) ||
+		    (conf.limits.depth < 1) || (conf.limits.depth > MAXDEPTH) ||
+		    (conf.limits.movetime < 0) || (conf.hashsize < 0) ||
+		    (conf.quiesce < 0) || (conf.quiesce > QUIESCEPLIES)) {
+			cerr << "Bad config: " << algorithms[a] << " " << evalfuncs[f] << " depth "
+			     << depths[d] << " movetime " << movetimes[t] << " hashsize " << hashsizes[h]
+			     << " quiescence " << quiesces[q] << endl;
+			return(3);
+		}
+
+		conf.name = conf.algorithm + "/" + conf.evalfunc + "/d" + depths[d];
+		if (conf.limits.movetime > 0) conf.name += "/t" + movetimes[t];
+		if (hashsizes.size() > 1) conf.name += "/h" + hashsizes[h];
+		if (conf.quiesce > 0) conf.name += "/q" + quiesces[q];
+		configs.push_back(conf);
+	}
+	return(0);
+}
+
+// Play random opening turns, same for the same opening number, adding
+// them to game record if any
+int RandomOpening ( Game &game, int opening, int plies, GameRecord *rec )
+{
+	unsigned int seed = 2654435761u * (opening + 1);
+	int playing = 1;
+	int turn;
+
+	for (turn = 0; turn < plies; turn++) {
+		char allowed[6];
+		char letters[MAXCHAIN];
+		int made = 0;
+		int moves = game.MovesAllowed (allowed, playing);
+		while (moves > 0) {	// Until turn ends
+			letters[made] = allowed[rand_r(&seed) % moves];
+			int endpt = game.KalahMove (playing, ChooseHole (playing, letters[made++]));
+			moves = (endpt == 6 ? game.MovesAllowed (allowed, playing) : 0);
+		}
+		if ((rec != NULL) && (made > 0)) {
+			rec->AddTurn (playing, letters, made, RECORDNOSCORE, 0, 0);
+		}
+		playing = Opponent(playing);
+	}
+	return(playing);
+}
+
+// Play one game without output, adding to both sides' totals and
+// recording it if asked
+void PlayGame ( vector<PlayerConfig> &configs, TournGame &tg, int plies,
+		TournTotals *firsttot, TournTotals *secondtot, GameRecord *rec )
+{
+	PlayerConfig &c1 = configs[tg.first];
+	PlayerConfig &c2 = configs[tg.second];
+	SearchContext context;		// This game's nodes and moves
+	Player p1(c1.algorithm, c1.evalfunc, 1, 0, c1.hashsize, c1.quiesce, &context);
+	Player p2(c2.algorithm, c2.evalfunc, 2, 0, c2.hashsize, c2.quiesce, &context);
+	TournTotals *tot[2] = { firsttot, secondtot };
+	SearchLimits *limits[2] = { &c1.limits, &c2.limits };
+
+	Game game;
+	if (rec != NULL) rec->Start (c1.name, c2.name);
+	int turn = RandomOpening (game, tg.opening, plies, rec) - 1;
+	int win = 0;
+	while (win <= 0) {		// Until game won
+		Player *pl = (turn == 0 ? &p1 : &p2);
+		struct timeval starter;
+		gettimeofday (&starter, NULL);
+		long nodes = context.Nodes();
+		int first = context.Records();
+
+		win = pl->TakeTurn (game, *limits[turn]);
+
+		if (context.Records() > first) {	// Not the turn finding no moves
+			tot[turn]->moves++;
+			tot[turn]->nodes += context.Nodes() - nodes;
+			tot[turn]->secs += TimeSince(&starter);
+		}
+		if ((rec != NULL) && (context.Records() > first)) {
+			char letters[MAXCHAIN];
+			int r;
+			for (r = first; r < context.Records(); r++) {
+				letters[r - first] = context.Recorded(r);
+			}
+			rec->AddTurn (pl->Who(), letters, context.Records() - first,
+				      pl->TurnFromBook() ? RECORDNOSCORE : pl->TurnScore(),
+				      context.Nodes() - nodes, TimeSince(&starter));
+		}
+		turn = 1 - turn;
+	}
+	if (rec != NULL) rec->Finish (game);
+
+	int margin = game.Score(1) - game.Score(2);
+	firsttot->margin += margin;
+	secondtot->margin -= margin;
+	if (margin == 0) {
+		firsttot->draws++;
+		secondtot->draws++;
+	} else if (margin > 0) {
+		firsttot->wins++;
+		secondtot->losses++;
+	} else {
+		firsttot->losses++;
+		secondtot->wins++;
+	}
+}
+
+// Tournament of all pairings of configs
+class Tournament {
+public:
+	Tournament ( vector<PlayerConfig> &c, int games, int plies, RecordWriter *w );
+
+	// Play all games on threads
+	void Play ( int threads );
+
+	// Output results
+	void WriteCSV ( ostream &out );
+	void WriteJSON ( ostream &out );
+
+private:
+	vector<PlayerConfig> configs;	// Players
+	vector<TournGame> games;	// Games to play
+	vector< pair<int,int> > pairings;  // Configs paired
+	vector<TournTotals> totals;	// Per pairing, first config then second
+	int plies;			// Random opening turns
+	mutex totallock;		// Totals shared by game threads
+	RecordWriter *writer;		// Game records, NULL if not kept
+
+	// Play games on one thread, taking the next from shared counter
+	void PlayGames ( atomic<long> *next );
+};
+
+Tournament::Tournament ( vector<PlayerConfig> &c, int g, int p, RecordWriter *w )
+	: configs(c), plies(p), writer(w)
+{
+	size_t a, b;
+	int n;
+
+	for (a = 0; a < configs.size(); a++) {
+		for (b = a+1; b < configs.size(); b++) {
+			int pairing = pairings.size();
+			pairings.push_back(make_pair((int)a, (int)b));
+			for (n = 0; n < g; n++) {  // Colours swap every game
+				TournGame tg;
+				tg.pairing = pairing;
+				tg.first = (n % 2 == 0 ? a : b);
+				tg.second = (n % 2 == 0 ? b : a);
+				tg.opening = n / 2;
+				games.push_back(tg);
+			}
+		}
+	}
+	TournTotals zero;
+	memset (&zero, 0, sizeof(zero));
+	totals.assign(2 * pairings.size(), zero);
+}
+
+// Play games on one thread, taking the next from shared counter
+void Tournament::PlayGames ( atomic<long> *next )
+{
+	GameRecord rec;			// Game being recorded
+	long g;
+	while ((g = (*next)++) < (long)games.size()) {
+		TournGame &tg = games[g];
+		TournTotals first, second;	// This game's totals
+		memset (&first, 0, sizeof(first));
+		memset (&second, 0, sizeof(second));
+		PlayGame (configs, tg, plies, &first, &second, writer != NULL ? &rec : NULL);
+		if (writer != NULL) writer->Write (rec);
+
+		int a = pairings[tg.pairing].first;
+		TournTotals *ta = &totals[2*tg.pairing];  // Config a's side
+		TournTotals *tb = &totals[2*tg.pairing+1];
+		TournTotals *tfirst = (tg.first == a ? ta : tb);
+		TournTotals *tsecond = (tg.first == a ? tb : ta);
+
+		lock_guard<mutex> hold(totallock);
+		TournTotals *from[2] = { &first, &second };
+		TournTotals *to[2] = { tfirst, tsecond };
+		int s;
+		for (s = 0; s < 2; s++) {
+			to[s]->wins += from[s]->wins;
+			to[s]->draws += from[s]->draws;
+			to[s]->losses += from[s]->losses;
+			to[s]->margin += from[s]->margin;
+			to[s]->moves += from[s]->moves;
+			to[s]->nodes += from[s]->nodes;
+			to[s]->secs += from[s]->secs;
+		}
+	}
+}
+
+// Play all games on threads
+void Tournament::Play ( int threads )
+{
+	atomic<long> next(0);
+	vector<thread> workers;
+	int t;
+
+	for (t = 1; t < threads; t++) {
+		workers.push_back(thread(&Tournament::PlayGames, this, &next));
+	}
+	PlayGames (&next);
+	for (t = 0; t < (int)workers.size(); t++) {
+		workers[t].join();
+	}
+}
+
+// Output results as CSV, one line per pairing
+void Tournament::WriteCSV ( ostream &out )
+{
+	size_t p;
+
+	out << "player_a,player_b,games,a_wins,draws,b_wins,a_avg_margin,"
+	    << "a_nodes_per_move,b_nodes_per_move,a_ms_per_move,b_ms_per_move" << endl;
+	for (p = 0; p < pairings.size(); p++) {
+		TournTotals &a = totals[2*p];
+		TournTotals &b = totals[2*p+1];
+		int played = a.wins + a.draws + a.losses;
+		out << configs[pairings[p].first].name << "," << configs[pairings[p].second].name << ","
+		    << played << "," << a.wins << "," << a.draws << "," << a.losses << ","
+		    << (played > 0 ? (double)a.margin / played : 0) << ","
+		    << (a.moves > 0 ? a.nodes / a.moves : 0) << ","
+		    << (b.moves > 0 ? b.nodes / b.moves : 0) << ","
+		    << (a.moves > 0 ? 1000 * a.secs / a.moves : 0) << ","
+		    << (b.moves > 0 ? 1000 * b.secs / b.moves : 0) << endl;
+	}
+}
+
+// Output results as JSON, one object per pairing
+void Tournament::WriteJSON ( ostream &out )
+{
+	size_t p;
+
+	out << "[" << endl;
+	for (p = 0; p < pairings.size(); p++) {
+		TournTotals &a = totals[2*p];
+		TournTotals &b = totals[2*p+1];
+		int played = a.wins + a.draws + a.losses;
+		out << "  {\"player_a\": \"" << configs[pairings[p].first].name << "\", "
+		    << "\"player_b\": \"" << configs[pairings[p].second].name << "\", "
+		    << "\"games\": " << played << ", "
+		    << "\"a_wins\": " << a.wins << ", \"draws\": " << a.draws << ", \"b_wins\": " << a.losses << ", "
+		    << "\"a_avg_margin\": " << (played > 0 ? (double)a.margin / played : 0) << ", "
+		    << "\"a_nodes_per_move\": " << (a.moves > 0 ? a.nodes / a.moves : 0) << ", "
+		    << "\"b_nodes_per_move\": " << (b.moves > 0 ? b.nodes / b.moves : 0) << ", "
+		    << "\"a_ms_per_move\": " << (a.moves > 0 ? 1000 * a.secs / a.moves : 0) << ", "
+		    << "\"b_ms_per_move\": " << (b.moves > 0 ? 1000 * b.secs / b.moves : 0) << "}"
+		    << (p+1 < pairings.size() ? "," : "") << endl;
+	}
+	out << "]" << endl;
+}
+
+int main ( int argc, char *argv[] )
+{
+	char *conffile = NULL;		// Config matrix
+	char *csvfile = NULL;		// CSV results
+	char *jsonfile = NULL;		// JSON results
+	char *recordfile = NULL;	// Game records
+	int games = TOURNGAMES;		// Games per pairing
+	int plies = TOURNPLIES;		// Random opening turns
+	int threads = thread::hardware_concurrency();
+	int opt;
+
+	while ((opt = getopt (argc, argv, "c:g:r:j:o:J:R:")) != -1) {
+		switch (opt) {
+		case 'c':		// Config matrix
+			conffile = optarg;
+			break;
+
+		case 'g':		// Games per pairing
+			games = atoi(optarg);
+			break;
+
+		case 'r':		// Random opening turns
+			plies = atoi(optarg);
+			break;
+
+		case 'j':		// Game threads
+			threads = atoi(optarg);
+			break;
+
+		case 'o':		// CSV results
+			csvfile = optarg;
+			break;
+
+		case 'J':		// JSON results
+			jsonfile = optarg;
+			break;
+
+		case 'R':		// Game records
+			recordfile = optarg;
+			break;
+
+		default:
+			Usage(argv);
+			return(1);
+		}
+	}
+	if ((conffile == NULL) || (games < 1) || (plies < 0)) {
+		Usage(argv);
+		return(1);
+	}
+	if (threads < 1) threads = 1;
+
+	vector<PlayerConfig> configs;
+	if (ReadConfigs (conffile, configs)) return(2);
+	if (configs.size() < 2) {
+		cerr << "At least two configs are needed." << endl;
+		return(2);
+	}
+
+	struct timeval starter;
+	gettimeofday (&starter, NULL);
+	RecordWriter writer;
+	if ((recordfile != NULL) && writer.Open (recordfile)) return(3);
+	Tournament tourn(configs, games, plies, recordfile != NULL ? &writer : NULL);
+	tourn.Play(threads);
+	cerr << "Tournament played in " << TimeSince(&starter) << " secs." << endl;
+
+	if (csvfile != NULL) {
+		ofstream csv(csvfile);
+		tourn.WriteCSV(csv);
+	}
+	if (jsonfile != NULL) {
+		ofstream json(jsonfile);
+		tourn.WriteJSON(json);
+	}
+	if ((csvfile == NULL) && (jsonfile == NULL)) {
+		tourn.WriteCSV(cout);
+	}
+	return(0);
+}